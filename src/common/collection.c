@@ -47,7 +47,9 @@
 /* Stores the collection query, returns 1 if changed.. */
 static int _dt_collection_store(const dt_collection_t *collection,
                                 gchar *query,
-                                gchar *query_no_group);
+                                gchar *query_no_group,
+                                gchar *where,
+                                gchar *where_no_group);
 /* Counts the number of images in the current collection */
 static uint32_t _dt_collection_compute_count(const dt_collection_t *collection,
                                              const gboolean no_group);
@@ -84,6 +86,8 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
     collection->where_ext = g_strdupv(clone->where_ext);
     collection->query = g_strdup(clone->query);
     collection->query_no_group = g_strdup(clone->query_no_group);
+    collection->where = g_strdup(clone->where);
+    collection->where_no_group = g_strdup(clone->where_no_group);
     collection->clone = 1;
     collection->count = clone->count;
     collection->count_no_group = clone->count_no_group;
@@ -126,6 +130,8 @@ void dt_collection_free(const dt_collection_t *collection)
 
   g_free(collection->query);
   g_free(collection->query_no_group);
+  g_free(collection->where);
+  g_free(collection->where_no_group);
   g_strfreev(collection->where_ext);
   g_free((dt_collection_t *)collection);
 }
@@ -186,16 +192,161 @@ void dt_collection_memory_update()
   // 2. insert collected images into the temporary table
   gchar *ins_query = g_strdup_printf("INSERT INTO memory.collected_images (imgid) %s", query);
 
+  const double start = dt_get_debug_wtime();
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), ins_query, -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF,
+           "[collection] memory update took %.3f secs\n",
+           dt_get_debug_wtime() - start);
 
   g_free(query);
   g_free(ins_query);
 }
 
+/* whether the position of an image in the sorted collection may depend
+ * on the given property */
+static gboolean _dt_collection_sort_depends_on(const dt_collection_t *collection,
+                                               const dt_collection_properties_t property)
+{
+  const gboolean *sorts = collection->params.sorts;
+
+  if(!(collection->params.query_flags & COLLECTION_QUERY_USE_SORT))
+    return FALSE;
+
+  if(property >= DT_COLLECTION_PROP_METADATA
+     && property < DT_COLLECTION_PROP_METADATA + DT_METADATA_NUMBER)
+    return sorts[DT_COLLECTION_SORT_TITLE] || sorts[DT_COLLECTION_SORT_DESCRIPTION];
+
+  switch(property)
+  {
+    case DT_COLLECTION_PROP_RATING:
+    case DT_COLLECTION_PROP_RATING_RANGE:
+      return sorts[DT_COLLECTION_SORT_RATING];
+    case DT_COLLECTION_PROP_COLORLABEL:
+      return sorts[DT_COLLECTION_SORT_COLOR];
+    case DT_COLLECTION_PROP_TAG:
+      return sorts[DT_COLLECTION_SORT_CUSTOM_ORDER];
+    case DT_COLLECTION_PROP_GEOTAGGING:
+      return FALSE;
+    default:
+      // we don't know what has changed
+      return TRUE;
+  }
+}
+
+/* apply the changes of the given images (comma separated ids) to
+ * memory.collected_images without re-running the whole collection
+ * query: only these images are checked against the WHERE part, the
+ * ones not matching anymore are removed and the following positions
+ * shifted. returns FALSE if some image has to enter the collection, as
+ * finding its position needs the full sorted query. */
+static gboolean _dt_collection_memory_update_delta(const dt_collection_t *collection,
+                                                   const gchar *ids)
+{
+  if(!collection->where || !ids) return FALSE;
+
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt = NULL;
+
+  // with grouping, changing an image might change which image
+  // represents its group. so we re-evaluate the whole groups.
+  gchar *changed = (darktable.gui && darktable.gui->grouping)
+    ? g_strdup_printf("SELECT id FROM main.images"
+                      " WHERE group_id IN (SELECT group_id FROM main.images"
+                      "                    WHERE id IN (%s))", ids)
+    : g_strdup(ids);
+
+  // clang-format off
+  gchar *query = g_strdup_printf
+    ("SELECT COUNT(*)"
+     " FROM main.images AS mi"
+     " WHERE mi.id IN (%s) AND (%s)"
+     "   AND mi.id NOT IN (SELECT imgid FROM memory.collected_images)",
+     changed, collection->where);
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  const gboolean entering = sqlite3_step(stmt) == SQLITE_ROW
+    && sqlite3_column_int(stmt, 0) > 0;
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  if(entering)
+  {
+    g_free(changed);
+    return FALSE;
+  }
+
+  // positions of the images leaving the collection, in order
+  // clang-format off
+  query = g_strdup_printf
+    ("SELECT rowid"
+     " FROM memory.collected_images"
+     " WHERE imgid IN (%s)"
+     "   AND imgid NOT IN (SELECT mi.id FROM main.images AS mi"
+     "                     WHERE mi.id IN (%s) AND (%s))"
+     " ORDER BY rowid",
+     changed, changed, collection->where);
+  // clang-format on
+  GArray *removed = g_array_new(FALSE, FALSE, sizeof(int));
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int rowid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(removed, rowid);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+  g_free(changed);
+
+  if(removed->len > 0)
+  {
+    // rowid is the position in the collection and has to stay
+    // contiguous. shift each segment between two removed images into
+    // negative space first so that no intermediate state collides.
+
+    for(int i = 0; i < removed->len; i++)
+    {
+      const int first = g_array_index(removed, int, i);
+      const int next = i + 1 < removed->len ? g_array_index(removed, int, i + 1) : G_MAXINT;
+
+      query = g_strdup_printf("DELETE FROM memory.collected_images WHERE rowid = %d", first);
+      DT_DEBUG_SQLITE3_EXEC(db, query, NULL, NULL, NULL);
+      g_free(query);
+
+      // clang-format off
+      query = g_strdup_printf("UPDATE memory.collected_images"
+                              " SET rowid = -(rowid - %d)"
+                              " WHERE rowid > %d AND rowid < %d",
+                              i + 1, first, next);
+      // clang-format on
+      DT_DEBUG_SQLITE3_EXEC(db, query, NULL, NULL, NULL);
+      g_free(query);
+    }
+
+    // clang-format off
+    DT_DEBUG_SQLITE3_EXEC(db,
+                          "UPDATE memory.collected_images"
+                          " SET rowid = -rowid"
+                          " WHERE rowid < 0",
+                          NULL, NULL, NULL);
+    DT_DEBUG_SQLITE3_EXEC(db,
+                          "UPDATE memory.sqlite_sequence"
+                          " SET seq = (SELECT IFNULL(MAX(rowid), 0) FROM memory.collected_images)"
+                          " WHERE name = 'collected_images'",
+                          NULL, NULL, NULL);
+    // clang-format on
+  }
+
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF,
+           "[collection] incremental memory update, %u images removed\n",
+           removed->len);
+  g_array_free(removed, TRUE);
+  return TRUE;
+}
+
 static void _dt_collection_set_selq_pre_sort(const dt_collection_t *collection,
                                              char **selq_pre)
 {
@@ -380,7 +531,7 @@ int dt_collection_update(const dt_collection_t *collection)
                         selq_pre, wq_no_group, selq_post, sq ? sq : "",
                         (collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
                         ? " " LIMIT_QUERY : "");
-  result = _dt_collection_store(collection, query, query_no_group);
+  result = _dt_collection_store(collection, query, query_no_group, wq, wq_no_group);
 
   /* free memory used */
   g_free(sq);
@@ -826,10 +977,52 @@ gchar *dt_collection_get_sort_query(const dt_collection_t *collection)
 }
 
 
+/* with -d sql -d perf, log the plan sqlite chose for a generated
+ * collection query. it makes it easy to spot filters that end up
+ * scanning the whole images table on large libraries. */
+static void _dt_collection_explain_query(const dt_collection_t *collection,
+                                         const gchar *query)
+{
+  if((darktable.unmuted & (DT_DEBUG_SQL | DT_DEBUG_PERF)) != (DT_DEBUG_SQL | DT_DEBUG_PERF)
+     || !query)
+    return;
+
+  sqlite3_stmt *stmt = NULL;
+  gchar *explain = g_strdup_printf("EXPLAIN QUERY PLAN %s", query);
+  if(sqlite3_prepare_v2(dt_database_get(darktable.db), explain, -1, &stmt, NULL) == SQLITE_OK)
+  {
+    if(collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
+    {
+      sqlite3_bind_int(stmt, 1, 0);
+      sqlite3_bind_int(stmt, 2, -1);
+    }
+
+    dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF, "[collection] query plan of \"%s\"\n", query);
+    // rows reference their parent node, indent them accordingly
+    GHashTable *depth = g_hash_table_new(NULL, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const int id = sqlite3_column_int(stmt, 0);
+      const int parent = sqlite3_column_int(stmt, 1);
+      const int level = GPOINTER_TO_INT(g_hash_table_lookup(depth, GINT_TO_POINTER(parent))) + 1;
+      g_hash_table_insert(depth, GINT_TO_POINTER(id), GINT_TO_POINTER(level));
+      dt_print_nts(DT_DEBUG_SQL | DT_DEBUG_PERF, "%*s%s\n",
+                   2 * level, "", (const char *)sqlite3_column_text(stmt, 3));
+    }
+    g_hash_table_destroy(depth);
+  }
+  sqlite3_finalize(stmt);
+  g_free(explain);
+}
+
 static int _dt_collection_store(const dt_collection_t *collection,
                                 gchar *query,
-                                gchar *query_no_group)
+                                gchar *query_no_group,
+                                gchar *where,
+                                gchar *where_no_group)
 {
+  _dt_collection_explain_query(collection, query);
+
   /* store flags to conf */
   if(collection == darktable.collection)
   {
@@ -845,6 +1038,11 @@ static int _dt_collection_store(const dt_collection_t *collection,
   ((dt_collection_t *)collection)->query = g_strdup(query);
   ((dt_collection_t *)collection)->query_no_group = g_strdup(query_no_group);
 
+  g_free(collection->where);
+  g_free(collection->where_no_group);
+  ((dt_collection_t *)collection)->where = g_strdup(where);
+  ((dt_collection_t *)collection)->where_no_group = g_strdup(where_no_group);
+
   return 1;
 }
 
@@ -2311,6 +2509,7 @@ void dt_collection_update_query(const dt_collection_t *collection,
                                 GList *list)
 {
   int next = -1;
+  gchar *txt = NULL;
   if(!collection->clone && query_change == DT_COLLECTION_CHANGE_NEW_QUERY
      && darktable.gui)
   {
@@ -2326,7 +2525,6 @@ void dt_collection_update_query(const dt_collection_t *collection,
       // untouched imageid after the list we do this here
 
       // 1. create a string with all the imgids of the list to be used inside IN sql query
-      gchar *txt = NULL;
       int i = 0;
       for(GList *l = list; l; l = g_list_next(l))
       {
@@ -2382,7 +2580,6 @@ void dt_collection_update_query(const dt_collection_t *collection,
         sqlite3_finalize(stmt2);
         g_free(query);
       }
-      g_free(txt);
     }
   }
 
@@ -2443,6 +2640,8 @@ void dt_collection_update_query(const dt_collection_t *collection,
     (collection,
      (dt_collection_get_filter_flags(collection) & ~COLLECTION_FILTER_FILM_ID));
 
+  gchar *old_query = g_strdup(collection->query);
+
   /* update query and at last the visual */
   //if(collection->clone) //TODO: check whether we need an
   //unconditional update here, slowing down the UI
@@ -2450,17 +2649,39 @@ void dt_collection_update_query(const dt_collection_t *collection,
                                        // update will be made by a
                                        // signal handler
 
+  // when some images have changed but the query is the same, only
+  // these images need to be re-evaluated, unless their position in the
+  // sort order may have changed too
+  const gboolean incremental = !collection->clone
+    && query_change == DT_COLLECTION_CHANGE_RELOAD
+    && txt
+    && collection->where_no_group
+    && !g_strcmp0(old_query, collection->query)
+    && !_dt_collection_sort_depends_on(collection, changed_property);
+  g_free(old_query);
+
   // remove from selected images where not in this query.
   sqlite3_stmt *stmt = NULL;
   const gchar *cquery = dt_collection_get_query_no_group(collection);
   if(cquery && cquery[0] != '\0')
   {
-    gchar *complete_query = g_strdup_printf("DELETE FROM main.selected_images"
-                                            " WHERE imgid NOT IN (%s)", cquery);
+    // clang-format off
+    gchar *complete_query = incremental
+      ? g_strdup_printf("DELETE FROM main.selected_images"
+                        " WHERE imgid IN (%s)"
+                        "   AND imgid NOT IN (SELECT mi.id FROM main.images AS mi"
+                        "                     WHERE mi.id IN (%s) AND (%s))",
+                        txt, txt, collection->where_no_group)
+      : g_strdup_printf("DELETE FROM main.selected_images"
+                        " WHERE imgid NOT IN (%s)", cquery);
+    // clang-format on
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                                 complete_query, -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
+    if(!incremental)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
+    }
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
     // if we have remove something from selection, we need to raise a signal
@@ -2476,12 +2697,17 @@ void dt_collection_update_query(const dt_collection_t *collection,
   /* raise signal of collection change, only if this is an original */
   if(!collection->clone)
   {
-    dt_collection_memory_update();
+    if(!incremental
+       || collection != darktable.collection
+       || !_dt_collection_memory_update_delta(collection, txt))
+      dt_collection_memory_update();
     DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals,
                                   DT_SIGNAL_COLLECTION_CHANGED,
                                   query_change, changed_property,
                                   list, next);
   }
+
+  g_free(txt);
 }
 
 gboolean dt_collection_hint_message_internal(void *message)
@@ -141,6 +141,7 @@ typedef struct dt_collection_t
 {
   int clone;
   gchar *query, *query_no_group;
+  gchar *where, *where_no_group; // WHERE parts of the above, on main.images AS mi
   gchar **where_ext;
   uint32_t count, count_no_group;
   uint32_t tagid;
@@ -48,7 +48,7 @@
 
 // whenever _create_*_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 48
+#define CURRENT_DATABASE_VERSION_LIBRARY 49
 #define CURRENT_DATABASE_VERSION_DATA    10
 
 // #define USE_NESTED_TRANSACTIONS
@@ -2627,6 +2627,54 @@ static int _upgrade_library_schema_step(dt_database_t *db, int version)
 
     new_version = 48;
   }
+  else if(version == 48)
+  {
+    // indexes for the columns filtered by collection queries on large
+    // libraries. the tag, color label and metadata ones are covering
+    // indexes so that the sub-selects never have to touch the tables.
+    // the maker/model/lens/camera ones also speed up the triggers
+    // cleaning up these tables when images are removed.
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_maker_id_index ON images (maker_id)",
+             "[init] can't create images_maker_id_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_model_id_index ON images (model_id)",
+             "[init] can't create images_model_id_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_lens_id_index ON images (lens_id)",
+             "[init] can't create images_lens_id_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_camera_id_index ON images (camera_id)",
+             "[init] can't create images_camera_id_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_iso_index ON images (iso)",
+             "[init] can't create images_iso_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_focal_length_index ON images (focal_length)",
+             "[init] can't create images_focal_length_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_exposure_index ON images (exposure)",
+             "[init] can't create images_exposure_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_import_timestamp_index"
+             " ON images (import_timestamp)",
+             "[init] can't create images_import_timestamp_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_change_timestamp_index"
+             " ON images (change_timestamp)",
+             "[init] can't create images_change_timestamp_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_export_timestamp_index"
+             " ON images (export_timestamp)",
+             "[init] can't create images_export_timestamp_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_print_timestamp_index"
+             " ON images (print_timestamp)",
+             "[init] can't create images_print_timestamp_index\n");
+
+    TRY_EXEC("DROP INDEX IF EXISTS main.tagged_images_tagid_index",
+             "[init] can't drop tagged_images_tagid_index\n");
+    TRY_EXEC("CREATE INDEX main.tagged_images_tagid_index ON tagged_images (tagid, imgid)",
+             "[init] can't create tagged_images_tagid_index\n");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.color_labels_color_index"
+             " ON color_labels (color, imgid)",
+             "[init] can't create color_labels_color_index\n");
+    TRY_EXEC("DROP INDEX IF EXISTS main.metadata_index_key",
+             "[init] can't drop metadata_index_key\n");
+    TRY_EXEC("CREATE INDEX main.metadata_index_key ON meta_data (key, value, id)",
+             "[init] can't create metadata_index_key\n");
+
+    new_version = 49;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -3016,6 +3064,39 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle,
                "CREATE INDEX main.images_datetime_taken_nc ON images (datetime_taken)",
                NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_maker_id_index ON images (maker_id)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_model_id_index ON images (model_id)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_lens_id_index ON images (lens_id)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_camera_id_index ON images (camera_id)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_iso_index ON images (iso)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_focal_length_index ON images (focal_length)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_exposure_index ON images (exposure)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_import_timestamp_index ON images (import_timestamp)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_change_timestamp_index ON images (change_timestamp)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_export_timestamp_index ON images (export_timestamp)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_print_timestamp_index ON images (print_timestamp)",
+               NULL, NULL, NULL);
 
   ////////////////////////////// selected_images
   sqlite3_exec(db->handle,
@@ -3049,17 +3130,20 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle, "CREATE TABLE main.tagged_images (imgid INTEGER, tagid INTEGER, position INTEGER, "
                            "PRIMARY KEY (imgid, tagid),"
                            "FOREIGN KEY(imgid) REFERENCES images(id) ON UPDATE CASCADE ON DELETE CASCADE)", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "CREATE INDEX main.tagged_images_tagid_index ON tagged_images (tagid)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.tagged_images_tagid_index ON tagged_images (tagid, imgid)",
+               NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.tagged_images_position_index ON tagged_images (position)", NULL, NULL, NULL);
   ////////////////////////////// color_labels
   sqlite3_exec(db->handle, "CREATE TABLE main.color_labels (imgid INTEGER, color INTEGER)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE UNIQUE INDEX main.color_labels_idx ON color_labels (imgid, color)", NULL, NULL,
                NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.color_labels_color_index ON color_labels (color, imgid)", NULL, NULL,
+               NULL);
   ////////////////////////////// meta_data
   sqlite3_exec(db->handle, "CREATE TABLE main.meta_data (id INTEGER, key INTEGER, value VARCHAR)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE UNIQUE INDEX main.metadata_index ON meta_data (id, key, value)", NULL, NULL, NULL);
 
-  sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index_key ON meta_data (key)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index_key ON meta_data (key, value, id)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE TABLE main.module_order (imgid INTEGER PRIMARY KEY, version INTEGER, iop_list VARCHAR)",
                NULL, NULL, NULL);
   sqlite3_exec
@@ -3226,6 +3310,8 @@ static void _create_memory_schema(dt_database_t *db)
       db->handle,
       "CREATE TABLE memory.collected_images (rowid INTEGER PRIMARY KEY AUTOINCREMENT, imgid INTEGER)", NULL,
       NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX memory.collected_images_imgid_index ON collected_images (imgid)",
+               NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE TABLE memory.tmp_selection (imgid INTEGER PRIMARY KEY)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE TABLE memory.taglist "
                            "(tmpid INTEGER PRIMARY KEY, id INTEGER UNIQUE ON CONFLICT IGNORE, "
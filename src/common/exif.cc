@@ -39,6 +39,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <exiv2/exiv2.hpp>
 
@@ -61,6 +62,7 @@ using namespace std;
 #include "common/dng_opcode.h"
 #include "common/image_cache.h"
 #include "common/exif.h"
+#include "common/file_location.h"
 #include "common/metadata.h"
 #include "common/ratings.h"
 #include "common/tags.h"
@@ -367,6 +369,304 @@ public:
   image->readMetadata();                                      \
 }
 
+// on-disk cache of the metadata blocks read from image files.
+//
+// to get at the exif, iptc and xmp data exiv2 has to open and walk the
+// whole container, which is expensive for raw files and even more so
+// on network storage. the decoded blocks are stored in the cache
+// directory keyed by the file identity (path, size, mtime and inode),
+// so that re-reading an unchanged file on import, refresh exif, the
+// crawler or copy/move is a small file read instead of a full parse.
+//
+// exif and iptc are stored datum by datum in their binary form (exiv2's
+// own exif encoder drops large tags to fit a jpeg segment), xmp is
+// stored as the raw packet.
+
+#define DT_EXIF_CACHE_VERSION 1
+
+static char _exif_cachedir[PATH_MAX] = { 0 };
+
+typedef struct dt_exif_cache_header_t
+{
+  char magic[8];
+  int32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t path_len;
+  int64_t size;
+  int64_t mtime;
+  int64_t inode;
+} dt_exif_cache_header_t;
+
+typedef struct dt_exif_cache_reader_t
+{
+  const guchar *data;
+  size_t len;
+  size_t pos;
+} dt_exif_cache_reader_t;
+
+static gboolean _exif_cache_enabled()
+{
+  return _exif_cachedir[0] && dt_conf_get_bool("cache_exif_metadata");
+}
+
+static gchar *_exif_cache_filename(const char *path)
+{
+  gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, path, -1);
+  // two levels so that large libraries don't end up in one huge directory
+  gchar *sub = g_strndup(hash, 2);
+  gchar *filename = g_build_filename(_exif_cachedir, sub, hash, NULL);
+  g_free(sub);
+  g_free(hash);
+  return filename;
+}
+
+static void _exif_cache_fill_header(dt_exif_cache_header_t *hdr,
+                                    const char *path,
+                                    const struct stat *statbuf)
+{
+  memset(hdr, 0, sizeof(dt_exif_cache_header_t));
+  memcpy(hdr->magic, "dtexifc", 8);
+  hdr->version = DT_EXIF_CACHE_VERSION;
+  hdr->path_len = strlen(path);
+  hdr->size = statbuf->st_size;
+  hdr->mtime = statbuf->st_mtime;
+  hdr->inode = statbuf->st_ino;
+}
+
+static gboolean _exif_cache_read(dt_exif_cache_reader_t *r,
+                                 void *dest,
+                                 const size_t n)
+{
+  if(r->pos + n > r->len) return FALSE;
+  memcpy(dest, r->data + r->pos, n);
+  r->pos += n;
+  return TRUE;
+}
+
+static void _exif_cache_append_datum(GByteArray *ba,
+                                     const std::string &key,
+                                     const Exiv2::TypeId type,
+                                     const Exiv2::byte *data,
+                                     const uint32_t len)
+{
+  const uint16_t key_len = key.size();
+  const uint16_t type_id = (uint16_t)type;
+  g_byte_array_append(ba, (guint8 *)&key_len, sizeof(key_len));
+  g_byte_array_append(ba, (guint8 *)key.c_str(), key_len);
+  g_byte_array_append(ba, (guint8 *)&type_id, sizeof(type_id));
+  g_byte_array_append(ba, (guint8 *)&len, sizeof(len));
+  if(len) g_byte_array_append(ba, (guint8 *)data, len);
+}
+
+// read one datum, returns FALSE if the cache file is truncated
+static gboolean _exif_cache_read_datum(dt_exif_cache_reader_t *r,
+                                       std::string &key,
+                                       Exiv2::TypeId *type,
+                                       std::vector<Exiv2::byte> &data)
+{
+  uint16_t key_len = 0, type_id = 0;
+  uint32_t len = 0;
+  if(!_exif_cache_read(r, &key_len, sizeof(key_len))
+     || r->pos + key_len > r->len)
+    return FALSE;
+  key.assign((const char *)r->data + r->pos, key_len);
+  r->pos += key_len;
+  if(!_exif_cache_read(r, &type_id, sizeof(type_id))
+     || !_exif_cache_read(r, &len, sizeof(len)))
+    return FALSE;
+  data.resize(len);
+  if(len && !_exif_cache_read(r, data.data(), len)) return FALSE;
+  *type = (Exiv2::TypeId)type_id;
+  return TRUE;
+}
+
+// returns TRUE if the cache holds valid data for this file identity
+static gboolean _exif_cache_load(const char *path,
+                                 const struct stat *statbuf,
+                                 Exiv2::ExifData &exifData,
+                                 Exiv2::IptcData &iptcData,
+                                 Exiv2::XmpData &xmpData,
+                                 int *width,
+                                 int *height)
+{
+  gchar *filename = _exif_cache_filename(path);
+  gchar *contents = NULL;
+  gsize length = 0;
+  const gboolean found = g_file_get_contents(filename, &contents, &length, NULL);
+  g_free(filename);
+  if(!found) return FALSE;
+
+  dt_exif_cache_reader_t r = { (const guchar *)contents, length, 0 };
+  dt_exif_cache_header_t hdr = { 0 }, expected;
+  _exif_cache_fill_header(&expected, path, statbuf);
+
+  gboolean ok = _exif_cache_read(&r, &hdr, sizeof(hdr))
+    && !memcmp(hdr.magic, expected.magic, sizeof(hdr.magic))
+    && hdr.version == expected.version
+    && hdr.path_len == expected.path_len
+    && hdr.size == expected.size
+    && hdr.mtime == expected.mtime
+    && hdr.inode == expected.inode
+    && r.pos + hdr.path_len <= r.len
+    && !memcmp(r.data + r.pos, path, hdr.path_len);
+
+  try
+  {
+    if(ok) r.pos += hdr.path_len;
+    std::string key;
+    std::vector<Exiv2::byte> data;
+    Exiv2::TypeId type;
+    uint32_t count = 0;
+
+    if(ok && (ok = _exif_cache_read(&r, &count, sizeof(count))))
+      for(uint32_t i = 0; i < count && ok; i++)
+      {
+        if((ok = _exif_cache_read_datum(&r, key, &type, data)))
+        {
+          auto value = Exiv2::Value::create(type);
+          value->read(data.data(), data.size(), Exiv2::littleEndian);
+          exifData.add(Exiv2::ExifKey(key), value.get());
+        }
+      }
+
+    if(ok && (ok = _exif_cache_read(&r, &count, sizeof(count))))
+      for(uint32_t i = 0; i < count && ok; i++)
+      {
+        if((ok = _exif_cache_read_datum(&r, key, &type, data)))
+        {
+          auto value = Exiv2::Value::create(type);
+          value->read(data.data(), data.size(), Exiv2::littleEndian);
+          iptcData.add(Exiv2::IptcKey(key), value.get());
+        }
+      }
+
+    uint32_t xmp_len = 0;
+    if(ok && (ok = _exif_cache_read(&r, &xmp_len, sizeof(xmp_len))
+              && r.pos + xmp_len <= r.len)
+       && xmp_len)
+    {
+      const std::string packet((const char *)r.data + r.pos, xmp_len);
+      ok = Exiv2::XmpParser::decode(xmpData, packet) == 0;
+    }
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[exif cache] invalid cache entry for %s: %s\n", path, e.what());
+    ok = FALSE;
+  }
+
+  g_free(contents);
+
+  if(ok)
+  {
+    *width = hdr.width;
+    *height = hdr.height;
+  }
+  else
+  {
+    exifData.clear();
+    iptcData.clear();
+    xmpData.clear();
+  }
+  return ok;
+}
+
+static void _exif_cache_store(const char *path,
+                              const struct stat *statbuf,
+                              const Exiv2::ExifData &exifData,
+                              const Exiv2::IptcData &iptcData,
+                              const Exiv2::XmpData &xmpData,
+                              const int width,
+                              const int height)
+{
+  try
+  {
+    std::string packet;
+    if(!xmpData.empty()
+       && Exiv2::XmpParser::encode(packet, xmpData,
+                                   Exiv2::XmpParser::useCompactFormat
+                                   | Exiv2::XmpParser::omitAllFormatting) != 0)
+      return;
+
+    dt_exif_cache_header_t hdr;
+    _exif_cache_fill_header(&hdr, path, statbuf);
+    hdr.width = width;
+    hdr.height = height;
+
+    GByteArray *ba = g_byte_array_new();
+    g_byte_array_append(ba, (guint8 *)&hdr, sizeof(hdr));
+    g_byte_array_append(ba, (guint8 *)path, hdr.path_len);
+
+    std::vector<Exiv2::byte> data;
+    uint32_t count = exifData.count();
+    g_byte_array_append(ba, (guint8 *)&count, sizeof(count));
+    for(const auto &datum : exifData)
+    {
+      data.resize(datum.size());
+      datum.copy(data.data(), Exiv2::littleEndian);
+      _exif_cache_append_datum(ba, datum.key(), datum.typeId(), data.data(), data.size());
+    }
+
+    count = iptcData.count();
+    g_byte_array_append(ba, (guint8 *)&count, sizeof(count));
+    for(const auto &datum : iptcData)
+    {
+      data.resize(datum.size());
+      datum.copy(data.data(), Exiv2::littleEndian);
+      _exif_cache_append_datum(ba, datum.key(), datum.typeId(), data.data(), data.size());
+    }
+
+    const uint32_t xmp_len = packet.size();
+    g_byte_array_append(ba, (guint8 *)&xmp_len, sizeof(xmp_len));
+    g_byte_array_append(ba, (guint8 *)packet.c_str(), xmp_len);
+
+    gchar *filename = _exif_cache_filename(path);
+    gchar *dirname = g_path_get_dirname(filename);
+    if(g_mkdir_with_parents(dirname, 0750) == 0)
+      g_file_set_contents(filename, (gchar *)ba->data, ba->len, NULL);
+    g_free(dirname);
+    g_free(filename);
+    g_byte_array_free(ba, TRUE);
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    dt_print(DT_DEBUG_IMAGEIO,
+             "[exif cache] can't cache metadata of %s: %s\n", path, e.what());
+  }
+}
+
+// read the metadata blocks of an image file, from the cache if the
+// file hasn't changed since it was last parsed. throws exiv2 errors.
+static void _exif_read_metadata(const char *path,
+                                const struct stat *statbuf,
+                                Exiv2::ExifData &exifData,
+                                Exiv2::IptcData &iptcData,
+                                Exiv2::XmpData &xmpData,
+                                int *width,
+                                int *height)
+{
+  const gboolean use_cache = statbuf && _exif_cache_enabled();
+
+  if(use_cache
+     && _exif_cache_load(path, statbuf, exifData, iptcData, xmpData, width, height))
+    return;
+
+  std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+  assert(image.get() != 0);
+  read_metadata_threadsafe(image);
+
+  exifData = image->exifData();
+  iptcData = image->iptcData();
+  xmpData = image->xmpData();
+  *width = image->pixelWidth();
+  *height = image->pixelHeight();
+
+  if(use_cache)
+    _exif_cache_store(path, statbuf, exifData, iptcData, xmpData, *width, *height);
+}
+
 static void _exif_import_tags(dt_image_t *img, Exiv2::XmpData::iterator &pos);
 
 static void _read_xmp_timestamps(Exiv2::XmpData &xmpData,
@@ -1024,12 +1324,17 @@ static gboolean _check_lens_correction_data(Exiv2::ExifData &exifData, dt_image_
 
 void dt_exif_img_check_additional_tags(dt_image_t *img, const char *filename)
 {
+  struct stat statbuf;
+  const gboolean have_stat = !stat(filename, &statbuf);
+
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(filename)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
-    Exiv2::ExifData &exifData = image->exifData();
+    Exiv2::ExifData exifData;
+    Exiv2::IptcData iptcData;
+    Exiv2::XmpData xmpData;
+    int width = 0, height = 0;
+    _exif_read_metadata(filename, have_stat ? &statbuf : NULL,
+                        exifData, iptcData, xmpData, &width, &height);
     if(!exifData.empty())
     {
       _check_usercrop(exifData, img);
@@ -2090,21 +2395,24 @@ gboolean dt_exif_read(dt_image_t *img, const char *path)
   // at least set datetime taken to something useful in case there is
   // no exif data in this file (pfm, png, ...)
   struct stat statbuf;
+  const gboolean have_stat = !stat(path, &statbuf);
 
-  if(!stat(path, &statbuf))
+  if(have_stat)
   {
     dt_datetime_unix_to_img(img, &statbuf.st_mtime);
   }
 
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
+    Exiv2::ExifData exifData;
+    Exiv2::IptcData iptcData;
+    Exiv2::XmpData xmpData;
+    int width = 0, height = 0;
+    _exif_read_metadata(path, have_stat ? &statbuf : NULL,
+                        exifData, iptcData, xmpData, &width, &height);
     bool res = true;
 
     // EXIF metadata
-    Exiv2::ExifData &exifData = image->exifData();
     if(!exifData.empty())
     {
       res = _exif_decode_exif_data(img, exifData);
@@ -2133,19 +2441,17 @@ gboolean dt_exif_read(dt_image_t *img, const char *path)
     dt_exif_apply_default_metadata(img);
 
     // IPTC metadata.
-    Exiv2::IptcData &iptcData = image->iptcData();
     if(!iptcData.empty()) res = _exif_decode_iptc_data(img, iptcData) && res;
 
     // XMP metadata
-    Exiv2::XmpData &xmpData = image->xmpData();
     if(!xmpData.empty())
       res = _exif_decode_xmp_data(img, xmpData, -1, true) && res;
 
     // Initialize size - don't wait for full raw to be loaded to get this
     // information. If use_embedded_thumbnail is set, it will take a
     // change in development history to have this information
-    img->height = image->pixelHeight();
-    img->width = image->pixelWidth();
+    img->height = height;
+    img->width = width;
 
     return res ? FALSE : TRUE;
   }
@@ -5647,6 +5953,11 @@ static void _exif_log_handler(const int log_level, const char *message)
 
 void dt_exif_init()
 {
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  if(cachedir[0])
+    snprintf(_exif_cachedir, sizeof(_exif_cachedir), "%s/exif.d", cachedir);
+
   // preface the exiv2 messages with "[exiv2] "
   Exiv2::LogMsg::setHandler(&_exif_log_handler);
 
@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "control/conf.h"
 #include "control/control.h"
 #include "develop/imageop.h"
 #include "develop/openmp_maths.h"
@@ -35,8 +36,8 @@
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
  * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * For large stamps, a few multigrid V-cycles compute an initial solution
+ * before the main iteration loop, which then only has to polish it.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -46,7 +47,7 @@
 
 
 // Subtract bottom from top and store in result as a float; separate 'red' and 'black' pixels into
-// two contiguous regions
+// two contiguous regions. A NULL bottom is taken as zero.
 static void _heal_sub(const float *const top_buffer, const float *const bottom_buffer,
                       float *const restrict red_buffer, float *const restrict black_buffer,
                       const size_t width, const size_t height)
@@ -71,8 +72,8 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
       const size_t idx = 4 * (row * width + 2*col);
       for_each_channel(c)
       {
-        buf1[4*col + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
-        buf2[4*col + c] = top_buffer[idx+4 + c] - bottom_buffer[idx+4 + c];
+        buf1[4*col + c] = top_buffer[idx + c] - (bottom_buffer ? bottom_buffer[idx + c] : 0.0f);
+        buf2[4*col + c] = top_buffer[idx+4 + c] - (bottom_buffer ? bottom_buffer[idx+4 + c] : 0.0f);
       }
     }
     if(width & 1)
@@ -83,7 +84,7 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
       const size_t idx = 4 * (row * width + (width-1));
       for_each_channel(c)
       {
-        buf1[4*res_idx + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
+        buf1[4*res_idx + c] = top_buffer[idx + c] - (bottom_buffer ? bottom_buffer[idx + c] : 0.0f);
         buf2[4*res_idx + c] = 0.0f;
       }
     }
@@ -95,7 +96,8 @@ static void _heal_sub(const float *const top_buffer, const float *const bottom_b
   memset(black_buffer + (height+1)*res_stride, 0, res_stride * sizeof(float));
 }
 
-// Add first to second and store in result, re-interleaving the 'red' and 'black' pixels
+// Add first to second and store in result, re-interleaving the 'red' and 'black' pixels. A NULL second is
+// taken as zero.
 static void _heal_add(const float *const restrict red_buffer, const float *const black_buffer,
                       const float *const restrict second_buffer, float *const restrict result_buffer,
                       const size_t width, const size_t height)
@@ -122,8 +124,8 @@ static void _heal_add(const float *const restrict red_buffer, const float *const
       const size_t idx = 4 * (row * width + 2*col);
       for_each_channel(c)
       {
-        result_buffer[idx + c] = buf1[4*col + c] + second_buffer[idx + c];
-        result_buffer[idx + 4 + c] = buf2[4*col + c] + second_buffer[idx + 4 + c];
+        result_buffer[idx + c] = buf1[4*col + c] + (second_buffer ? second_buffer[idx + c] : 0.0f);
+        result_buffer[idx + 4 + c] = buf2[4*col + c] + (second_buffer ? second_buffer[idx + 4 + c] : 0.0f);
       }
     }
     if(width & 1)
@@ -132,7 +134,7 @@ static void _heal_add(const float *const restrict red_buffer, const float *const
       const size_t res_idx = (width-1)/2;
       const size_t idx = 4 * (row * width + (width-1));
       for_each_channel(c)
-        result_buffer[idx + c] = buf1[4*res_idx + c] + second_buffer[idx + c];
+        result_buffer[idx + c] = buf1[4*res_idx + c] + (second_buffer ? second_buffer[idx + c] : 0.0f);
     }
   }
 }
@@ -314,8 +316,8 @@ static void collect_runs(const int start, const float *const restrict mask, cons
   }
 }
 
-// Solve the laplace equation for pixels and store the result in-place.
-static void _heal_laplace_loop(float *const restrict red_pixels, float *const restrict black_pixels,
+// Solve the laplace equation for pixels and store the result in-place, return the number of iterations done.
+static int _heal_laplace_loop(float *const restrict red_pixels, float *const restrict black_pixels,
                                const size_t width, const size_t height,
                                const float *const restrict mask, const int max_iter)
 {
@@ -327,6 +329,7 @@ static void _heal_laplace_loop(float *const restrict red_pixels, float *const re
   // a handful of runs in each row of pixels.
   // Note that using `unsigned` instead of size_t, the stamp is limited to ~8 gigapixels (the main image can be larger)
   const size_t subwidth = (width+1)/2;  // round up to be able to handle odd widths
+  int iter = 0;
   unsigned *const restrict red_runs = dt_alloc_align_type(unsigned, subwidth * (height + 2));
   unsigned *const restrict black_runs = dt_alloc_align_type(unsigned, subwidth * (height + 2));
   if(!red_runs || !black_runs)
@@ -362,11 +365,12 @@ static void _heal_laplace_loop(float *const restrict red_pixels, float *const re
   const float err_exit = epsilon * epsilon * w * w;
 
   /* Gauss-Seidel with successive over-relaxation */
-  for(int iter = 0; iter < max_iter; iter++)
+  while(iter < max_iter)
   {
     // process red/black cells separately
     float err = _heal_laplace_iteration(black_pixels, red_pixels, height, subwidth, black_runs, num_black, 1, w);
     err += _heal_laplace_iteration(red_pixels, black_pixels, height, subwidth, red_runs, num_red, 0, w);
+    iter++;
 
     if(err < err_exit) break;
   }
@@ -374,22 +378,327 @@ static void _heal_laplace_loop(float *const restrict red_pixels, float *const re
 cleanup:
   if(red_runs) dt_free_align(red_runs);
   if(black_runs) dt_free_align(black_runs);
+  return iter;
 }
 
 
-/* Original Algorithm Design:
+/* Multigrid
  *
- * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
- * http://www.tgeorgiev.net/Photoshop_Healing.pdf
+ * Gauss-Seidel only smooths out the high frequencies of the error quickly, the number of iterations needed
+ * grows with the size of the stamp. We therefore run a few V-cycles first: the residual is restricted to
+ * grids of half the size down to a few pixels, where a handful of iterations settle the low frequencies,
+ * and the corrections are interpolated back up. The unknowns are the pixels under the mask, everything
+ * else is a Dirichlet boundary (zero for the corrections on the coarser grids). The image borders are
+ * Neumann boundaries, as in the loop above: neighbors outside the stamp are not counted.
  */
-void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
-             const int height, const int ch, const int max_iter)
+
+#define HEAL_MG_MIN_PIXELS 4096 // below, SOR alone is faster than setting up the grids
+#define HEAL_MG_COARSEST 8      // stop halving when both dimensions are this small
+#define HEAL_MG_MAX_LEVELS 16
+#define HEAL_MG_MAX_CYCLES 8
+#define HEAL_MG_SMOOTH 2        // Gauss-Seidel sweeps before and after each coarse correction
+#define HEAL_MG_COARSE_ITER 64  // Gauss-Seidel sweeps on the coarsest grid
+
+typedef struct _heal_grid_t
 {
-  if(ch != 4)
+  float *u;       // solution on the finest grid, correction on the coarser ones; 4 floats per pixel
+  float *f;       // right-hand side, NULL on the finest grid where it is zero
+  uint8_t *mask;  // unknowns
+  size_t width, height;
+} _heal_grid_t;
+
+// red/black Gauss-Seidel sweeps of  a * u - sum(neighbors) = f  over the masked pixels, a being the number
+// of neighbors inside the grid. returns the sum of the squared updates of the last sweep.
+static float _heal_mg_smooth(const _heal_grid_t *const g, const int sweeps)
+{
+  float *const restrict u = g->u;
+  const float *const restrict f = g->f;
+  const uint8_t *const restrict mask = g->mask;
+  const size_t width = g->width;
+  const size_t height = g->height;
+  float err = 0.0f;
+
+  for(int sweep = 0; sweep < sweeps; sweep++)
   {
-    dt_print(DT_DEBUG_ALWAYS, "dt_heal: full-color image required\n");
-    return;
+    err = 0.0f;
+    for(int color = 0; color < 2; color++)
+    {
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(u, f, mask, width, height, color) \
+  schedule(static) reduction(+ : err)
+#endif
+      for(size_t row = 0; row < height; row++)
+      {
+        for(size_t col = (row + color) & 1; col < width; col += 2)
+        {
+          const size_t k = row * width + col;
+          if(!mask[k]) continue;
+          float a = 0.0f;
+          dt_aligned_pixel_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+          if(f) for_each_channel(c) sum[c] = f[4*k + c];
+          if(row > 0)
+          {
+            a += 1.0f;
+            for_each_channel(c) sum[c] += u[4*(k - width) + c];
+          }
+          if(row + 1 < height)
+          {
+            a += 1.0f;
+            for_each_channel(c) sum[c] += u[4*(k + width) + c];
+          }
+          if(col > 0)
+          {
+            a += 1.0f;
+            for_each_channel(c) sum[c] += u[4*(k - 1) + c];
+          }
+          if(col + 1 < width)
+          {
+            a += 1.0f;
+            for_each_channel(c) sum[c] += u[4*(k + 1) + c];
+          }
+          if(a == 0.0f) continue;
+          for_each_channel(c)
+          {
+            const float v = sum[c] / a;
+            const float d = v - u[4*k + c];
+            u[4*k + c] = v;
+            err += d * d;
+          }
+        }
+      }
+    }
+  }
+  return err;
+}
+
+// residual  f - (a * u - sum(neighbors))  of one masked pixel
+static inline void _heal_mg_residual(const _heal_grid_t *const g, const size_t row, const size_t col,
+                                     dt_aligned_pixel_t res)
+{
+  const float *const restrict u = g->u;
+  const size_t width = g->width;
+  const size_t k = row * width + col;
+  float a = 0.0f;
+  for_each_channel(c) res[c] = g->f ? g->f[4*k + c] : 0.0f;
+  if(row > 0)
+  {
+    a += 1.0f;
+    for_each_channel(c) res[c] += u[4*(k - width) + c];
+  }
+  if(row + 1 < g->height)
+  {
+    a += 1.0f;
+    for_each_channel(c) res[c] += u[4*(k + width) + c];
+  }
+  if(col > 0)
+  {
+    a += 1.0f;
+    for_each_channel(c) res[c] += u[4*(k - 1) + c];
+  }
+  if(col + 1 < width)
+  {
+    a += 1.0f;
+    for_each_channel(c) res[c] += u[4*(k + 1) + c];
+  }
+  for_each_channel(c) res[c] -= a * u[4*k + c];
+}
+
+// sum the residuals of the fine grid over 2x2 blocks into the right-hand side of the coarse grid, and clear
+// its correction. the operator isn't scaled by the grid spacing, so summing gives the proper weight.
+static void _heal_mg_restrict(const _heal_grid_t *const fine, const _heal_grid_t *const coarse)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fine, coarse) \
+  schedule(static)
+#endif
+  for(size_t row = 0; row < coarse->height; row++)
+  {
+    for(size_t col = 0; col < coarse->width; col++)
+    {
+      const size_t k = row * coarse->width + col;
+      dt_aligned_pixel_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+      if(coarse->mask[k])
+      {
+        for(size_t i = 2 * row; i < MIN(2 * row + 2, fine->height); i++)
+          for(size_t j = 2 * col; j < MIN(2 * col + 2, fine->width); j++)
+          {
+            if(!fine->mask[i * fine->width + j]) continue;
+            dt_aligned_pixel_t res;
+            _heal_mg_residual(fine, i, j, res);
+            for_each_channel(c) sum[c] += res[c];
+          }
+      }
+      copy_pixel(coarse->f + 4*k, sum);
+      for_each_channel(c) coarse->u[4*k + c] = 0.0f;
+    }
+  }
+}
+
+// bilinear interpolation of the coarse correction, added to the masked pixels of the fine grid
+static void _heal_mg_prolong(const _heal_grid_t *const coarse, const _heal_grid_t *const fine)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fine, coarse) \
+  schedule(static)
+#endif
+  for(size_t row = 0; row < fine->height; row++)
+  {
+    // fine pixel centers sit a quarter of a coarse pixel away from the center of their parent
+    const size_t r0 = row / 2;
+    const size_t r1 = (row & 1) ? MIN(r0 + 1, coarse->height - 1) : (r0 > 0 ? r0 - 1 : 0);
+    for(size_t col = 0; col < fine->width; col++)
+    {
+      const size_t k = row * fine->width + col;
+      if(!fine->mask[k]) continue;
+      const size_t c0 = col / 2;
+      const size_t c1 = (col & 1) ? MIN(c0 + 1, coarse->width - 1) : (c0 > 0 ? c0 - 1 : 0);
+      const float *const p00 = coarse->u + 4 * (r0 * coarse->width + c0);
+      const float *const p01 = coarse->u + 4 * (r0 * coarse->width + c1);
+      const float *const p10 = coarse->u + 4 * (r1 * coarse->width + c0);
+      const float *const p11 = coarse->u + 4 * (r1 * coarse->width + c1);
+      for_each_channel(c)
+        fine->u[4*k + c] += (9.0f * p00[c] + 3.0f * (p01[c] + p10[c]) + p11[c]) / 16.0f;
+    }
+  }
+}
+
+// one V-cycle from the given level down, returns the sum of the squared updates of its last sweep
+static float _heal_mg_vcycle(const _heal_grid_t *const grids, const int level, const int num_levels)
+{
+  const _heal_grid_t *const g = grids + level;
+  if(level == num_levels - 1)
+    return _heal_mg_smooth(g, HEAL_MG_COARSE_ITER);
+
+  _heal_mg_smooth(g, HEAL_MG_SMOOTH);
+  _heal_mg_restrict(g, g + 1);
+  _heal_mg_vcycle(grids, level + 1, num_levels);
+  _heal_mg_prolong(g + 1, g);
+  return _heal_mg_smooth(g, HEAL_MG_SMOOTH);
+}
+
+// solve the laplace equation for the masked pixels of buffer (4 floats per pixel) with multigrid V-cycles,
+// in-place. returns the number of cycles done, 0 if we could not set up the grids.
+static int _heal_multigrid(float *const buffer, const float *const mask_buffer, const size_t width,
+                           const size_t height)
+{
+  _heal_grid_t grids[HEAL_MG_MAX_LEVELS] = { { 0 } };
+  int num_levels = 0;
+  int cycles = 0;
+  size_t nmask = 0;
+
+  grids[0].u = buffer;
+  grids[0].width = width;
+  grids[0].height = height;
+  uint8_t *const restrict mask = grids[0].mask = dt_alloc_align_uint8(width * height);
+  if(!mask) goto cleanup;
+  num_levels = 1;
+
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(mask, mask_buffer, width, height) \
+  schedule(static) reduction(+ : nmask)
+#endif
+  for(size_t k = 0; k < width * height; k++)
+  {
+    mask[k] = mask_buffer[k] != 0.0f;
+    nmask += mask[k];
+  }
+  if(nmask == 0) goto cleanup;
+
+  // a coarse pixel is an unknown as soon as one of the fine pixels it covers is
+  while(num_levels < HEAL_MG_MAX_LEVELS
+        && (grids[num_levels-1].width > HEAL_MG_COARSEST || grids[num_levels-1].height > HEAL_MG_COARSEST))
+  {
+    const _heal_grid_t *const fine = grids + num_levels - 1;
+    _heal_grid_t *const coarse = grids + num_levels;
+    coarse->width = (fine->width + 1) / 2;
+    coarse->height = (fine->height + 1) / 2;
+    const size_t npixels = coarse->width * coarse->height;
+    coarse->u = dt_alloc_align_float(4 * npixels);
+    coarse->f = dt_alloc_align_float(4 * npixels);
+    coarse->mask = dt_alloc_align_uint8(npixels);
+    num_levels++;
+    if(!coarse->u || !coarse->f || !coarse->mask) goto cleanup;
+
+    for(size_t row = 0; row < coarse->height; row++)
+      for(size_t col = 0; col < coarse->width; col++)
+      {
+        uint8_t m = 0;
+        for(size_t i = 2 * row; i < MIN(2 * row + 2, fine->height); i++)
+          for(size_t j = 2 * col; j < MIN(2 * col + 2, fine->width); j++)
+            m |= fine->mask[i * fine->width + j];
+        coarse->mask[row * coarse->width + col] = m;
+      }
+  }
+
+  // same exit criterion as the SOR loop, which takes over from here
+  const float epsilon = (0.1 / 255);
+  while(cycles < HEAL_MG_MAX_CYCLES)
+  {
+    const float err = _heal_mg_vcycle(grids, 0, num_levels);
+    cycles++;
+    if(err < epsilon * epsilon * nmask) break;
+  }
+
+cleanup:
+  if(grids[0].mask) dt_free_align(grids[0].mask);
+  for(int l = 1; l < num_levels; l++)
+  {
+    if(grids[l].u) dt_free_align(grids[l].u);
+    if(grids[l].f) dt_free_align(grids[l].f);
+    if(grids[l].mask) dt_free_align(grids[l].mask);
+  }
+  return cycles;
+}
+
+
+// run the multigrid solver on the difference between dest and src (dest alone if src is NULL) and store
+// the result back into the masked pixels of dest, as initial solution for the SOR loop
+static int _heal_initial_solution(const float *const src_buffer, float *const dest_buffer,
+                                  const float *const mask_buffer, const size_t width, const size_t height)
+{
+  if(!src_buffer) return _heal_multigrid(dest_buffer, mask_buffer, width, height);
+
+  const size_t npixels = width * height;
+  float *const restrict diff = dt_alloc_align_float(4 * npixels);
+  if(!diff) return 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(src_buffer, dest_buffer, diff, npixels) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < 4 * npixels; k++)
+    diff[k] = dest_buffer[k] - src_buffer[k];
+
+  const int cycles = _heal_multigrid(diff, mask_buffer, width, height);
+
+  if(cycles)
+  {
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(src_buffer, dest_buffer, mask_buffer, diff, npixels) \
+  schedule(static)
+#endif
+    for(size_t k = 0; k < npixels; k++)
+      if(mask_buffer[k] != 0.0f)
+        for_each_channel(c) dest_buffer[4*k + c] = src_buffer[4*k + c] + diff[4*k + c];
   }
+
+  dt_free_align(diff);
+  return cycles;
+}
+
+static void _heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer,
+                  const int width, const int height, const int max_iter)
+{
+  double start = dt_get_debug_wtime();
+  int cycles = 0;
+  int iter = 0;
+
   const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
   float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
   float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
@@ -399,19 +708,48 @@ void dt_heal(const float *const src_buffer, float *dest_buffer, const float *con
     goto cleanup;
   }
 
+  if((size_t)width * height >= HEAL_MG_MIN_PIXELS && dt_conf_get_bool("heal_multigrid"))
+    cycles = _heal_initial_solution(src_buffer, dest_buffer, mask_buffer, width, height);
+  const double mg_time = dt_get_lap_time(&start);
+
   /* subtract pattern from image and store the result split by 'red' and 'black' positions  */
   _heal_sub(dest_buffer, src_buffer, red_buffer, black_buffer, width, height);
 
-  _heal_laplace_loop(red_buffer, black_buffer, width, height, mask_buffer, max_iter);
+  iter = _heal_laplace_loop(red_buffer, black_buffer, width, height, mask_buffer, max_iter);
 
   /* add solution to original image and store in dest */
   _heal_add(red_buffer, black_buffer, src_buffer, dest_buffer, width, height);
 
+  dt_print(DT_DEBUG_PERF, "[dt_heal] %dx%d: %d multigrid cycles in %.3f secs, %d SOR iterations in %.3f secs\n",
+           width, height, cycles, mg_time, iter, dt_get_lap_time(&start));
+
 cleanup:
   if(red_buffer) dt_free_align(red_buffer);
   if(black_buffer) dt_free_align(black_buffer);
 }
 
+/* Original Algorithm Design:
+ *
+ * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
+ * http://www.tgeorgiev.net/Photoshop_Healing.pdf
+ */
+void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
+             const int height, const int ch, const int max_iter)
+{
+  if(ch != 4)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "dt_heal: full-color image required\n");
+    return;
+  }
+  _heal(src_buffer, dest_buffer, mask_buffer, width, height, max_iter);
+}
+
+void dt_heal_laplace(float *buffer, const float *const mask_buffer, const int width, const int height,
+                     const int max_iter)
+{
+  _heal(NULL, buffer, mask_buffer, width, height, max_iter);
+}
+
 #ifdef HAVE_OPENCL
 
 dt_heal_cl_global_t *dt_heal_init_cl_global()
@@ -25,6 +25,12 @@
 void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
              const int height, const int ch, const int max_iter);
 
+/* replaces the pixels of buffer (4 channels) where mask_buffer != 0.f by a smooth membrane interpolation of
+ * the surrounding ones, i.e. the solution of the laplace equation with the unmasked pixels as boundary
+ */
+void dt_heal_laplace(float *buffer, const float *const mask_buffer, const int width, const int height,
+                     const int max_iter);
+
 #ifdef HAVE_OPENCL
 
 typedef struct dt_heal_cl_global_t
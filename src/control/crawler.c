@@ -25,6 +25,8 @@
 #include "common/darktable.h"
 #include "common/database.h"
 #include "common/debug.h"
+#include "common/file_location.h"
+#include "common/grealpath.h"
 #include "common/history.h"
 #include "common/image.h"
 #include "control/conf.h"
@@ -103,16 +105,117 @@ static void _set_modification_time(char *filename,
   if(info) g_clear_object(&info);
 }
 
+// the folder index remembers the modification time of every film roll
+// folder in which all images were found in sync during the last
+// crawl. creating, deleting or replacing a sidecar (or a .txt/.wav
+// file) updates the folder's mtime, so folders with an unchanged mtime
+// can be skipped without looking at any of their files. this makes
+// startup checks on large (network) libraries scale with the number of
+// changed folders instead of the number of images.
+
+#define DT_CRAWLER_INDEX_HEADER "darktable crawler index 1"
+
+static gchar *_crawler_index_filename(void)
+{
+  const gchar *dbfilename = dt_database_get_path(darktable.db);
+  if(!strcmp(dbfilename, ":memory:")) return NULL;
+
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+
+  gchar *abspath = g_realpath(dbfilename);
+  if(!abspath) abspath = g_strdup(dbfilename);
+  gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, abspath, -1);
+  gchar *filename = g_strdup_printf("%s/crawler-%s.idx", cachedir, hash);
+  g_free(hash);
+  g_free(abspath);
+  return filename;
+}
+
+static GHashTable *_crawler_index_load(const char *filename)
+{
+  GHashTable *index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  gchar *contents = NULL;
+
+  if(filename
+     && g_file_get_contents(filename, &contents, NULL, NULL)
+     && g_str_has_prefix(contents, DT_CRAWLER_INDEX_HEADER "\n"))
+  {
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for(gchar **line = lines + 1; *line; line++)
+    {
+      gchar *folder = strchr(*line, '\t');
+      if(!folder) continue;
+      *folder++ = '\0';
+      gint64 *mtime = g_malloc(sizeof(gint64));
+      *mtime = g_ascii_strtoll(*line, NULL, 10);
+      g_hash_table_insert(index, g_strdup(folder), mtime);
+    }
+    g_strfreev(lines);
+  }
+
+  g_free(contents);
+  return index;
+}
+
+static void _crawler_index_save(const char *filename, GHashTable *index)
+{
+  if(!filename) return;
+
+  GString *contents = g_string_new(DT_CRAWLER_INDEX_HEADER "\n");
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, index);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+    g_string_append_printf(contents, "%" G_GINT64_FORMAT "\t%s\n",
+                           *(gint64 *)value, (char *)key);
+
+  if(!g_file_set_contents(filename, contents->str, contents->len, NULL))
+    dt_print(DT_DEBUG_CONTROL, "[crawler] can't write folder index `%s'\n", filename);
+  g_string_free(contents, TRUE);
+}
+
+// record the finished folder in the new index if it can be trusted next time
+static void _crawler_index_commit_folder(GHashTable *new_index,
+                                         const char *folder,
+                                         const gint64 folder_mtime,
+                                         const gboolean in_sync,
+                                         const time_t start)
+{
+  // folders touched during this second might still change without a
+  // visible mtime update
+  if(folder && in_sync && folder_mtime > 0 && folder_mtime < start)
+  {
+    gint64 *mtime = g_malloc(sizeof(gint64));
+    *mtime = folder_mtime;
+    g_hash_table_insert(new_index, g_strdup(folder), mtime);
+  }
+}
+
 GList *dt_control_crawler_run(void)
 {
   sqlite3_stmt *stmt, *inner_stmt;
   GList *result = NULL;
   gboolean look_for_xmp = (dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER);
 
+  const gboolean use_index = dt_conf_get_bool("run_crawler_skip_unchanged_folders");
+  gchar *index_filename = use_index ? _crawler_index_filename() : NULL;
+  GHashTable *index = use_index ? _crawler_index_load(index_filename) : NULL;
+  GHashTable *new_index = use_index
+    ? g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free)
+    : NULL;
+  const time_t start = time(NULL);
+  gchar *current_folder = NULL;
+  gint64 folder_mtime = 0;
+  gboolean skip_folder = FALSE;
+  gboolean folder_in_sync = TRUE;
+  int skipped = 0, skipped_folders = 0;
+
   // clang-format off
   sqlite3_prepare_v2(dt_database_get(darktable.db),
                      "SELECT i.id, write_timestamp, version,"
-                     "       folder || '" G_DIR_SEPARATOR_S "' || filename, flags"
+                     "       folder || '" G_DIR_SEPARATOR_S "' || filename, flags,"
+                     "       folder"
                      " FROM main.images i, main.film_rolls f"
                      " ON i.film_id = f.id"
                      " ORDER BY f.id, filename",
@@ -132,6 +235,29 @@ GList *dt_control_crawler_run(void)
     const int version = sqlite3_column_int(stmt, 2);
     const gchar *image_path = (char *)sqlite3_column_text(stmt, 3);
     int flags = sqlite3_column_int(stmt, 4);
+    const gchar *folder = (char *)sqlite3_column_text(stmt, 5);
+
+    if(use_index && g_strcmp0(folder, current_folder))
+    {
+      // images come sorted by film roll, so the previous folder is done
+      _crawler_index_commit_folder(new_index, current_folder, folder_mtime,
+                                   folder_in_sync, start);
+      g_free(current_folder);
+      current_folder = g_strdup(folder);
+
+      GStatBuf statbuf;
+      folder_mtime = g_stat(folder, &statbuf) ? 0 : statbuf.st_mtime;
+      const gint64 *last_mtime = g_hash_table_lookup(index, folder);
+      skip_folder = last_mtime && folder_mtime > 0 && *last_mtime == folder_mtime;
+      folder_in_sync = TRUE;
+      if(skip_folder) skipped_folders++;
+    }
+
+    if(skip_folder)
+    {
+      skipped++;
+      continue;
+    }
 
     // if the image is missing we ignore it.
     if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
@@ -188,6 +314,7 @@ GList *dt_control_crawler_run(void)
         item->xmp_path = g_strdup(xmp_path);
 
         result = g_list_prepend(result, item);
+        folder_in_sync = FALSE;
         dt_print(DT_DEBUG_CONTROL,
                  "[crawler] `%s' (id: %d) is a newer XMP file.\n", xmp_path, id);
       }
@@ -258,6 +385,20 @@ GList *dt_control_crawler_run(void)
   sqlite3_finalize(stmt);
   sqlite3_finalize(inner_stmt);
 
+  if(use_index)
+  {
+    _crawler_index_commit_folder(new_index, current_folder, folder_mtime,
+                                 folder_in_sync, start);
+    _crawler_index_save(index_filename, new_index);
+    dt_print(DT_DEBUG_CONTROL,
+             "[crawler] skipped %d images in %d unchanged folders\n",
+             skipped, skipped_folders);
+    g_hash_table_destroy(index);
+    g_hash_table_destroy(new_index);
+    g_free(current_folder);
+    g_free(index_filename);
+  }
+
   return g_list_reverse(result); // list was built in reverse order, so un-reverse it
 }
 
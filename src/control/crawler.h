@@ -30,6 +30,8 @@
 // - the XMP file on disk is newer than the timestamp from db
 // - there is a .txt or .wav file associated with the image and mark so in the db
 //   or if such a file no longer exists
+// if run_crawler_skip_unchanged_folders is set, folders whose mtime didn't change since
+// they were last found in sync are skipped entirely (see the folder index in crawler.c)
 // it returns the list of images with a (supposedly) updated xmp file to let the user decide
 GList *dt_control_crawler_run();
 
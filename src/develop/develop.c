@@ -82,6 +82,7 @@ void dt_dev_init(dt_develop_t *dev,
   dev->form_visible = NULL;
   dev->form_gui = NULL;
   dev->allforms = NULL;
+  dev->mask_raster_cache = dt_masks_raster_cache_new();
 
   if(dev->gui_attached)
   {
@@ -197,6 +198,7 @@ void dt_dev_cleanup(dt_develop_t *dev)
 
   g_list_free_full(dev->forms, (void (*)(void *))dt_masks_free_form);
   g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
+  dt_masks_raster_cache_free(dev->mask_raster_cache);
 
   dt_conf_set_int("darkroom/ui/rawoverexposed/mode",
                   dev->rawoverexposed.mode);
@@ -3129,6 +3131,259 @@ gboolean dt_dev_distort_backtransform(dt_develop_t *dev,
     (dev, dev->preview_pipe, 0.0f, DT_DEV_TRANSFORM_DIR_ALL, points, points_count);
 }
 
+static inline gboolean _dev_distort_applies(dt_develop_t *dev,
+                                            dt_dev_pixelpipe_t *pipe,
+                                            const dt_iop_module_t *module,
+                                            const dt_dev_pixelpipe_iop_t *piece,
+                                            const double iop_order,
+                                            const dt_dev_transform_direction_t transf_direction)
+{
+  return piece->enabled
+    && piece->data
+    && ((transf_direction == DT_DEV_TRANSFORM_DIR_ALL)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_INCL
+            && module->iop_order >= iop_order)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_EXCL
+            && module->iop_order > iop_order)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_INCL
+            && module->iop_order <= iop_order)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_EXCL
+            && module->iop_order < iop_order))
+    && !(dt_iop_module_is_skipped(dev, module)
+         && (pipe->type & DT_DEV_PIXELPIPE_BASIC));
+}
+
+/*
+ * the forward distortion of a pipe up to a module, sampled on a coarse
+ * grid over the pipe input. large point sets (mask borders, overlays) are
+ * then transformed with a bilinear lookup instead of going through every
+ * distort_transform(). a grid is only used if it reproduces the exact
+ * transform at the center of each cell, and points outside of it are
+ * still transformed exactly.
+ */
+#define DT_DEV_DISTORT_GRID_MIN_POINTS 512  // below that, transform exactly
+#define DT_DEV_DISTORT_GRID_MAX_CELLS 128   // along the largest side
+#define DT_DEV_DISTORT_GRID_MAX_ERROR 0.25f // in pixels
+#define DT_DEV_DISTORT_GRID_CACHED 8        // grids kept per pipe
+
+typedef struct dt_dev_distort_grid_t
+{
+  dt_hash_t hash;
+  float step;
+  int nx, ny;
+  float *nodes; // nx * ny transformed positions, NULL if not accurate enough
+} dt_dev_distort_grid_t;
+
+static void _dev_distort_grid_free(gpointer data)
+{
+  dt_dev_distort_grid_t *grid = (dt_dev_distort_grid_t *)data;
+  dt_free_align(grid->nodes);
+  free(grid);
+}
+
+void dt_dev_distort_grids_cleanup(dt_dev_pixelpipe_t *pipe)
+{
+  g_list_free_full(pipe->distort_grids, _dev_distort_grid_free);
+  pipe->distort_grids = NULL;
+}
+
+// returns 0 if the distortions can't be sampled on a grid
+static dt_hash_t _dev_distort_grid_hash(dt_develop_t *dev,
+                                        dt_dev_pixelpipe_t *pipe,
+                                        const double iop_order,
+                                        const dt_dev_transform_direction_t transf_direction)
+{
+  dt_hash_t hash = DT_INITHASH;
+  hash = dt_hash(hash, &iop_order, sizeof(iop_order));
+  hash = dt_hash(hash, &transf_direction, sizeof(transf_direction));
+  hash = dt_hash(hash, &pipe->image.id, sizeof(pipe->image.id));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+
+  GList *modules = pipe->iop;
+  GList *pieces = pipe->nodes;
+  while(modules)
+  {
+    if(!pieces) return 0;
+    dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)(pieces->data);
+    if(_dev_distort_applies(dev, pipe, module, piece, iop_order, transf_direction))
+    {
+      if(module->flags() & IOP_FLAGS_LOCAL_DISTORT) return 0;
+      hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
+    }
+    modules = g_list_next(modules);
+    pieces = g_list_next(pieces);
+  }
+  return hash;
+}
+
+static dt_dev_distort_grid_t *_dev_distort_grid_get(dt_develop_t *dev,
+                                                    dt_dev_pixelpipe_t *pipe,
+                                                    const double iop_order,
+                                                    const dt_dev_transform_direction_t transf_direction)
+{
+  if(pipe->iwidth <= 0 || pipe->iheight <= 0) return NULL;
+
+  const dt_hash_t hash = _dev_distort_grid_hash(dev, pipe, iop_order, transf_direction);
+  if(hash == 0) return NULL;
+
+  for(GList *l = pipe->distort_grids; l; l = g_list_next(l))
+  {
+    dt_dev_distort_grid_t *grid = (dt_dev_distort_grid_t *)l->data;
+    if(grid->hash == hash)
+    {
+      pipe->distort_grids = g_list_remove_link(pipe->distort_grids, l);
+      pipe->distort_grids = g_list_concat(l, pipe->distort_grids);
+      return grid->nodes ? grid : NULL;
+    }
+  }
+
+  const double start = dt_get_debug_wtime();
+
+  const float step = fmaxf(16.0f, (float)MAX(pipe->iwidth, pipe->iheight)
+                                  / DT_DEV_DISTORT_GRID_MAX_CELLS);
+  const int nx = ceilf(pipe->iwidth / step) + 1;
+  const int ny = ceilf(pipe->iheight / step) + 1;
+  const size_t nb_nodes = (size_t)nx * ny;
+  const size_t nb_centers = (size_t)(nx - 1) * (ny - 1);
+
+  dt_dev_distort_grid_t *grid = calloc(1, sizeof(dt_dev_distort_grid_t));
+  // the nodes followed by the centers of the cells to check the accuracy
+  float *pts = dt_alloc_align_float(2 * (nb_nodes + nb_centers));
+  if(!grid || !pts)
+  {
+    free(grid);
+    dt_free_align(pts);
+    return NULL;
+  }
+  grid->hash = hash;
+  grid->step = step;
+  grid->nx = nx;
+  grid->ny = ny;
+
+  for(int j = 0; j < ny; j++)
+    for(int i = 0; i < nx; i++)
+    {
+      pts[2 * (j * nx + i)] = i * step;
+      pts[2 * (j * nx + i) + 1] = j * step;
+    }
+  float *centers = pts + 2 * nb_nodes;
+  for(int j = 0; j < ny - 1; j++)
+    for(int i = 0; i < nx - 1; i++)
+    {
+      centers[2 * (j * (nx - 1) + i)] = (i + 0.5f) * step;
+      centers[2 * (j * (nx - 1) + i) + 1] = (j + 0.5f) * step;
+    }
+
+  dt_dev_distort_transform_locked(dev, pipe, iop_order, transf_direction,
+                                  pts, nb_nodes + nb_centers);
+
+  float max_error = 0.0f;
+  for(int j = 0; j < ny - 1 && max_error <= DT_DEV_DISTORT_GRID_MAX_ERROR; j++)
+    for(int i = 0; i < nx - 1; i++)
+    {
+      const float *n00 = pts + 2 * (j * nx + i);
+      const float *n10 = n00 + 2;
+      const float *n01 = n00 + 2 * nx;
+      const float *n11 = n01 + 2;
+      const float *c = centers + 2 * (j * (nx - 1) + i);
+      const float ex = 0.25f * (n00[0] + n10[0] + n01[0] + n11[0]) - c[0];
+      const float ey = 0.25f * (n00[1] + n10[1] + n01[1] + n11[1]) - c[1];
+      const float error = sqrtf(ex * ex + ey * ey);
+      // also catches NaN
+      if(!(error <= max_error)) max_error = isnan(error) ? INFINITY : error;
+    }
+
+  if(max_error <= DT_DEV_DISTORT_GRID_MAX_ERROR)
+  {
+    grid->nodes = dt_alloc_align_float(2 * nb_nodes);
+    if(grid->nodes) memcpy(grid->nodes, pts, sizeof(float) * 2 * nb_nodes);
+  }
+  dt_free_align(pts);
+
+  dt_print(DT_DEBUG_DEV | DT_DEBUG_PERF,
+           "[dev_distort_transform] %s grid %dx%d up to %.4f, max error %.3f px%s, took %.4f sec\n",
+           dt_dev_pixelpipe_type_to_str(pipe->type), nx, ny, iop_order, max_error,
+           grid->nodes ? "" : " (not used)", dt_get_debug_wtime() - start);
+
+  // we keep inaccurate grids too, so that we don't sample them again
+  pipe->distort_grids = g_list_prepend(pipe->distort_grids, grid);
+  while(g_list_length(pipe->distort_grids) > DT_DEV_DISTORT_GRID_CACHED)
+  {
+    GList *last = g_list_last(pipe->distort_grids);
+    _dev_distort_grid_free(last->data);
+    pipe->distort_grids = g_list_delete_link(pipe->distort_grids, last);
+  }
+
+  return grid->nodes ? grid : NULL;
+}
+
+static void _dev_distort_grid_transform(dt_develop_t *dev,
+                                        dt_dev_pixelpipe_t *pipe,
+                                        const dt_dev_distort_grid_t *grid,
+                                        const double iop_order,
+                                        const dt_dev_transform_direction_t transf_direction,
+                                        float *points,
+                                        const size_t points_count)
+{
+  const float xmax = (grid->nx - 1) * grid->step;
+  const float ymax = (grid->ny - 1) * grid->step;
+
+  // points out of the grid (or markers in the list) are gathered to be
+  // transformed exactly
+  size_t *outside = NULL;
+  size_t nb_outside = 0;
+
+  for(size_t k = 0; k < points_count; k++)
+  {
+    const float x = points[2 * k];
+    const float y = points[2 * k + 1];
+    if(!(x >= 0.0f && x < xmax && y >= 0.0f && y < ymax))
+    {
+      if(!outside) outside = malloc(sizeof(size_t) * points_count);
+      if(outside) outside[nb_outside++] = k;
+      continue;
+    }
+
+    const float fx = x / grid->step;
+    const float fy = y / grid->step;
+    const int i = MIN((int)fx, grid->nx - 2);
+    const int j = MIN((int)fy, grid->ny - 2);
+    const float u = fx - i;
+    const float v = fy - j;
+    const float *n00 = grid->nodes + 2 * (j * grid->nx + i);
+    const float *n10 = n00 + 2;
+    const float *n01 = n00 + 2 * grid->nx;
+    const float *n11 = n01 + 2;
+    for(int c = 0; c < 2; c++)
+      points[2 * k + c] = (1.0f - v) * ((1.0f - u) * n00[c] + u * n10[c])
+                          + v * ((1.0f - u) * n01[c] + u * n11[c]);
+  }
+
+  if(nb_outside)
+  {
+    float *pts = dt_alloc_align_float(2 * nb_outside);
+    if(pts)
+    {
+      for(size_t k = 0; k < nb_outside; k++)
+      {
+        pts[2 * k] = points[2 * outside[k]];
+        pts[2 * k + 1] = points[2 * outside[k] + 1];
+      }
+      dt_dev_distort_transform_locked(dev, pipe, iop_order, transf_direction,
+                                      pts, nb_outside);
+      for(size_t k = 0; k < nb_outside; k++)
+      {
+        points[2 * outside[k]] = pts[2 * k];
+        points[2 * outside[k] + 1] = pts[2 * k + 1];
+      }
+      dt_free_align(pts);
+    }
+  }
+  free(outside);
+}
+
 // only call directly or indirectly from
 // dt_dev_distort_transform_plus, so that it runs with the history
 // locked
@@ -3150,19 +3405,7 @@ gboolean dt_dev_distort_transform_locked
     }
     dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
     dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)(pieces->data);
-    if(piece->enabled
-       && piece->data
-       && ((transf_direction == DT_DEV_TRANSFORM_DIR_ALL)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_INCL
-               && module->iop_order >= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_EXCL
-               && module->iop_order > iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_INCL
-               && module->iop_order <= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_EXCL
-               && module->iop_order < iop_order))
-       && !(dt_iop_module_is_skipped(dev, module)
-            && (pipe->type & DT_DEV_PIXELPIPE_BASIC)))
+    if(_dev_distort_applies(dev, pipe, module, piece, iop_order, transf_direction))
     {
       module->distort_transform(module, piece, points, points_count);
     }
@@ -3181,8 +3424,16 @@ gboolean dt_dev_distort_transform_plus
    const size_t points_count)
 {
   dt_pthread_mutex_lock(&dev->history_mutex);
-  dt_dev_distort_transform_locked(dev, pipe, iop_order, transf_direction,
-                                  points, points_count);
+  const dt_dev_distort_grid_t *grid =
+    points_count >= DT_DEV_DISTORT_GRID_MIN_POINTS
+    ? _dev_distort_grid_get(dev, pipe, iop_order, transf_direction)
+    : NULL;
+  if(grid)
+    _dev_distort_grid_transform(dev, pipe, grid, iop_order, transf_direction,
+                                points, points_count);
+  else
+    dt_dev_distort_transform_locked(dev, pipe, iop_order, transf_direction,
+                                    points, points_count);
   dt_pthread_mutex_unlock(&dev->history_mutex);
   return TRUE;
 }
@@ -3208,19 +3459,7 @@ gboolean dt_dev_distort_backtransform_locked
     }
     dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
     dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)(pieces->data);
-    if(piece->enabled
-       && piece->data
-       && ((transf_direction == DT_DEV_TRANSFORM_DIR_ALL)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_INCL
-               && module->iop_order >= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_EXCL
-               && module->iop_order > iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_INCL
-               && module->iop_order <= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_EXCL
-               && module->iop_order < iop_order))
-       && !(dt_iop_module_is_skipped(dev, module)
-            && (pipe->type & DT_DEV_PIXELPIPE_BASIC)))
+    if(_dev_distort_applies(dev, pipe, module, piece, iop_order, transf_direction))
     {
       module->distort_backtransform(module, piece, points, points_count);
     }
@@ -221,6 +221,8 @@ typedef struct dt_develop_t
   struct dt_masks_form_gui_t *form_gui;
   // all forms to be linked here for cleanup:
   GList *allforms;
+  // rasterized shapes reused between pipe runs
+  struct dt_masks_raster_cache_t *mask_raster_cache;
 
   //full preview stuff
   gboolean full_preview;
@@ -554,6 +556,8 @@ gboolean dt_dev_distort_transform_plus
    const dt_dev_transform_direction_t transf_direction,
    float *points,
    const size_t points_count);
+/** free the distortion grids cached by dt_dev_distort_transform_plus */
+void dt_dev_distort_grids_cleanup(struct dt_dev_pixelpipe_t *pipe);
 /** same fct, but can only be called from a distort_transform function
  * called by dt_dev_distort_transform_plus */
 gboolean dt_dev_distort_transform_locked
@@ -133,7 +133,8 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_UNSAFE_COPY = 1 << 13,       // Unsafe to copy as part of history
   IOP_FLAGS_GUIDES_SPECIAL_DRAW = 1 << 14, // handle the grid drawing directly
   IOP_FLAGS_GUIDES_WIDGET = 1 << 15,      // require the guides widget
-  IOP_FLAGS_CROP_EXPOSER = 1 << 16        // offers crop exposing
+  IOP_FLAGS_CROP_EXPOSER = 1 << 16,       // offers crop exposing
+  IOP_FLAGS_LOCAL_DISTORT = 1 << 17       // distortion too local to be interpolated on a coarse grid
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -591,6 +591,10 @@ void dt_masks_iop_combo_populate(GtkWidget *w,
                                  struct dt_iop_module_t **m);
 void dt_masks_iop_use_same_as(struct dt_iop_module_t *module,
                               struct dt_iop_module_t *src);
+/** cache of rasterized shapes, owned by the develop */
+struct dt_masks_raster_cache_t *dt_masks_raster_cache_new(void);
+void dt_masks_raster_cache_free(struct dt_masks_raster_cache_t *cache);
+
 int dt_masks_group_get_hash_buffer_length(dt_masks_form_t *form);
 char *dt_masks_group_get_hash_buffer(dt_masks_form_t *form,
                                      char *str);
@@ -886,6 +890,42 @@ int dt_masks_roundup(const int num, const int mult)
   return (rem == 0) ? num : num + mult - rem;
 }
 
+/* restrict the steps [*first, *last[ of a falloff segment walked from
+   (x0, y0) by (sx, sy) per step to those which may touch the rectangle
+   [xmin, xmax[ x [ymin, ymax[. a margin of two pixels accounts for the
+   rounding and the neighbour pixels written by the falloff functions. */
+static inline
+void dt_masks_clip_segment_steps(const float x0,
+                                 const float y0,
+                                 const float sx,
+                                 const float sy,
+                                 const int xmin,
+                                 const int xmax,
+                                 const int ymin,
+                                 const int ymax,
+                                 int *first,
+                                 int *last)
+{
+  const float o[2] = { x0, y0 };
+  const float s[2] = { sx, sy };
+  const float lo[2] = { xmin - 2, ymin - 2 };
+  const float hi[2] = { xmax + 2, ymax + 2 };
+
+  for(int k = 0; k < 2; k++)
+  {
+    if(s[k] == 0.0f)
+    {
+      if(o[k] < lo[k] || o[k] >= hi[k]) *last = *first;
+      continue;
+    }
+    const float t0 = (lo[k] - o[k]) / s[k];
+    const float t1 = (hi[k] - o[k]) / s[k];
+    *first = MAX(*first, (int)floorf(MIN(t0, t1)));
+    *last = MIN(*last, (int)ceilf(MAX(t0, t1)) + 1);
+  }
+  if(*last < *first) *last = *first;
+}
+
 #define DT_MASKS_CONF(type, shape, param) \
   (type & (DT_MASKS_CLONE | DT_MASKS_NON_CLONE) \
    ? "plugins/darkroom/spots/" #shape "_" #param \
@@ -3001,14 +3001,17 @@ static int _brush_get_mask(const dt_iop_module_t *const module,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
+/** we write a falloff segment respecting limits of buffer, only the
+ * rows [y0, y1[ are touched */
 static inline void _brush_falloff_roi(float *buffer,
                                       const int *p0,
                                       const int *p1,
                                       const int bw,
                                       const int bh,
                                       const float hardness,
-                                      const float density)
+                                      const float density,
+                                      const int y0,
+                                      const int y1)
 {
   // segment length (increase by 1 to avoid division-by-zero special
   // case handling)
@@ -3024,29 +3027,29 @@ static inline void _brush_falloff_roi(float *buffer,
   const int dpx = dx;
   const int dpy = dy * bw;
 
-  float fx = p0[0];
-  float fy = p0[1];
-
-  float op = density;
   const float dop = density / (float)(l - solid);
 
-  for(int i = 0; i < l; i++)
-  {
-    const int x = fx;
-    const int y = fy;
+  // skip the parts of the segment which can't reach the rows we own
+  int first = 0, last = l;
+  dt_masks_clip_segment_steps(p0[0], p0[1], lx, ly, 0, bw, y0, y1, &first, &last);
 
-    fx += lx;
-    fy += ly;
-    if(i > solid) op -= dop;
+  for(int i = first; i < last; i++)
+  {
+    const int x = p0[0] + i * lx;
+    const int y = p0[1] + i * ly;
+    const float op = (i > solid) ? density - (float)(i - solid) * dop : density;
 
     if(x < 0 || x >= bw || y < 0 || y >= bh) continue;
 
     float *buf = buffer + (size_t)y * bw + x;
 
-    *buf = MAX(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
+    if(y >= y0 && y < y1)
+    {
+      *buf = MAX(*buf, op);
+      if(x + dx >= 0 && x + dx < bw)
+        buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
+    }
+    if(y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gaps due to int rounding
   }
 }
@@ -3126,26 +3129,37 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
     return 1;
   }
 
-  // now we fill the falloff
+  // now we fill the falloff. the segments overlap, so rather than
+  // walking them in parallel and racing on the buffer, the roi is split
+  // in bands of rows and each band walks only the part of the segments
+  // which crosses it.
+  const int nb_bands = MAX(1, MIN(height, 4 * dt_get_num_threads()));
 #ifdef _OPENMP
 #if !defined(__SUNOS__) && !defined(__NetBSD__)
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(nb_corner, border_count, width, height) \
-  shared(buffer, points, border, payload) schedule(static)
+  dt_omp_firstprivate(nb_corner, border_count, width, height, nb_bands) \
+  shared(buffer, points, border, payload) schedule(dynamic)
 #else
 #pragma omp parallel for shared(buffer)
 #endif
 #endif
-  for(int i = _nb_ctrl_point(nb_corner); i < border_count; i++)
+  for(int band = 0; band < nb_bands; band++)
   {
-    const int p0[] = { points[i * 2], points[i * 2 + 1] };
-    const int p1[] = { border[i * 2], border[i * 2 + 1] };
+    const int y0 = (int)((size_t)height * band / nb_bands);
+    const int y1 = (int)((size_t)height * (band + 1) / nb_bands);
 
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
+    for(int i = _nb_ctrl_point(nb_corner); i < border_count; i++)
+    {
+      const int p0[] = { points[i * 2], points[i * 2 + 1] };
+      const int p1[] = { border[i * 2], border[i * 2 + 1] };
+
+      if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < y0 - 1
+         || MIN(p0[1], p1[1]) > y1)
+        continue;
 
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
+      _brush_falloff_roi(buffer, p0, p1, width, height,
+                         payload[i * 2], payload[i * 2 + 1], y0, y1);
+    }
   }
 
   dt_free_align(points);
@@ -708,6 +708,185 @@ static void _combine_masks_exclusion(float *const restrict dest,
   }
 }
 
+// rasterized shapes are kept per develop, keyed by the shape itself, the roi
+// and the distortions applied before the module. this way a pipe run
+// triggered by a change in another module doesn't rasterize them again.
+#define DT_MASKS_RASTER_CACHE_SIZE (128 * 1024 * 1024)
+
+typedef struct dt_masks_raster_cache_entry_t
+{
+  dt_hash_t hash;
+  size_t npixels;
+  float *buffer;
+} dt_masks_raster_cache_entry_t;
+
+typedef struct dt_masks_raster_cache_t
+{
+  dt_pthread_mutex_t lock;
+  GList *entries; // most recently used first
+  size_t size;    // in bytes
+} dt_masks_raster_cache_t;
+
+static void _raster_cache_entry_free(gpointer data)
+{
+  dt_masks_raster_cache_entry_t *entry = (dt_masks_raster_cache_entry_t *)data;
+  dt_free_align(entry->buffer);
+  free(entry);
+}
+
+dt_masks_raster_cache_t *dt_masks_raster_cache_new(void)
+{
+  dt_masks_raster_cache_t *cache = calloc(1, sizeof(dt_masks_raster_cache_t));
+  dt_pthread_mutex_init(&cache->lock, NULL);
+  return cache;
+}
+
+void dt_masks_raster_cache_free(dt_masks_raster_cache_t *cache)
+{
+  if(!cache) return;
+  g_list_free_full(cache->entries, _raster_cache_entry_free);
+  dt_pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+static gboolean _raster_cache_get(dt_masks_raster_cache_t *cache,
+                                  const dt_hash_t hash,
+                                  float *const buffer,
+                                  const size_t npixels)
+{
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&cache->lock);
+  for(GList *l = cache->entries; l; l = g_list_next(l))
+  {
+    dt_masks_raster_cache_entry_t *entry = (dt_masks_raster_cache_entry_t *)l->data;
+    if(entry->hash == hash && entry->npixels == npixels)
+    {
+      memcpy(buffer, entry->buffer, sizeof(float) * npixels);
+      cache->entries = g_list_remove_link(cache->entries, l);
+      cache->entries = g_list_concat(l, cache->entries);
+      found = TRUE;
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+  return found;
+}
+
+static void _raster_cache_put(dt_masks_raster_cache_t *cache,
+                              const dt_hash_t hash,
+                              const float *const buffer,
+                              const size_t npixels)
+{
+  const size_t size = sizeof(float) * npixels;
+  // don't let a single huge mask flush everything else
+  if(size > DT_MASKS_RASTER_CACHE_SIZE / 4) return;
+
+  float *copy = dt_alloc_align_float(npixels);
+  dt_masks_raster_cache_entry_t *entry = malloc(sizeof(dt_masks_raster_cache_entry_t));
+  if(!copy || !entry)
+  {
+    dt_free_align(copy);
+    free(entry);
+    return;
+  }
+  memcpy(copy, buffer, size);
+  entry->hash = hash;
+  entry->npixels = npixels;
+  entry->buffer = copy;
+
+  dt_pthread_mutex_lock(&cache->lock);
+  cache->entries = g_list_prepend(cache->entries, entry);
+  cache->size += size;
+  // evict the least recently used rasters
+  while(cache->size > DT_MASKS_RASTER_CACHE_SIZE)
+  {
+    GList *last = g_list_last(cache->entries);
+    dt_masks_raster_cache_entry_t *old = (dt_masks_raster_cache_entry_t *)last->data;
+    cache->size -= sizeof(float) * old->npixels;
+    cache->entries = g_list_delete_link(cache->entries, last);
+    _raster_cache_entry_free(old);
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
+// the hash of everything the raster of a single shape depends on, 0 if
+// the shape must not be cached
+static dt_hash_t _raster_hash(dt_masks_form_t *const form,
+                              const dt_iop_roi_t *const roi,
+                              const dt_dev_pixelpipe_iop_t *const piece,
+                              const dt_hash_t distort_hash)
+{
+  // nested groups are resolved through darktable.develop, not the
+  // develop of the pipe, so we can't trust their hash buffer here
+  if(distort_hash == 0 || (form->type & DT_MASKS_GROUP)) return 0;
+
+  const int len = dt_masks_group_get_hash_buffer_length(form);
+  char *str = malloc(len);
+  if(!str) return 0;
+  dt_masks_group_get_hash_buffer(form, str);
+  dt_hash_t hash = dt_hash(DT_INITHASH, str, len);
+  free(str);
+
+  hash = dt_hash(hash, &roi->x, sizeof(roi->x));
+  hash = dt_hash(hash, &roi->y, sizeof(roi->y));
+  hash = dt_hash(hash, &roi->width, sizeof(roi->width));
+  hash = dt_hash(hash, &roi->height, sizeof(roi->height));
+  hash = dt_hash(hash, &roi->scale, sizeof(roi->scale));
+  hash = dt_hash(hash, &piece->pipe->iwidth, sizeof(piece->pipe->iwidth));
+  hash = dt_hash(hash, &piece->pipe->iheight, sizeof(piece->pipe->iheight));
+  hash = dt_hash(hash, &piece->pipe->iscale, sizeof(piece->pipe->iscale));
+  hash = dt_hash(hash, &distort_hash, sizeof(distort_hash));
+  return hash;
+}
+
+static void _combine_mask(float *const restrict buffer,
+                          const float *const restrict bufs,
+                          const size_t npixels,
+                          const int state,
+                          const float op)
+{
+  // first see if we need to invert this shape
+  const int inverted = (state & DT_MASKS_STATE_INVERSE);
+
+  if(state & DT_MASKS_STATE_UNION)
+  {
+    _combine_masks_union(buffer, bufs, npixels, op, inverted);
+  }
+  else if(state & DT_MASKS_STATE_INTERSECTION)
+  {
+    _combine_masks_intersect(buffer, bufs, npixels, op, inverted);
+  }
+  else if(state & DT_MASKS_STATE_DIFFERENCE)
+  {
+    _combine_masks_difference(buffer, bufs, npixels, op, inverted);
+  }
+  else if(state & DT_MASKS_STATE_SUM)
+  {
+    _combine_masks_sum(buffer, bufs, npixels, op, inverted);
+  }
+  else if(state & DT_MASKS_STATE_EXCLUSION)
+  {
+    _combine_masks_exclusion(buffer, bufs, npixels, op, inverted);
+  }
+  else // if we are here, this mean that we just have to copy
+       // the shape and null other parts
+  {
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for simd default(none) \
+    dt_omp_firstprivate(npixels, op, inverted) \
+    dt_omp_sharedconst(buffer, bufs) schedule(simd:static) aligned(buffer, bufs : 64)
+#else
+#pragma omp parallel for shared(bufs, buffer)
+#endif
+#endif
+    for(int index = 0; index < npixels; index++)
+    {
+      buffer[index] = op * (inverted ? (1.0f - bufs[index]) : bufs[index]);
+    }
+  }
+}
+
 static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
                                const dt_dev_pixelpipe_iop_t *const restrict piece,
                                dt_masks_form_t *const form,
@@ -716,37 +895,109 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
 {
   if(!form->points) return 0;
   double start = dt_get_debug_wtime();
+  const double start_group = start;
   int nb_ok = 0;
 
   const int width = roi->width;
   const int height = roi->height;
   const size_t npixels = (size_t)width * height;
 
-  // we need to allocate a zeroed temporary buffer for intermediate
-  // creation of individual shapes
-  float *const restrict bufs = dt_alloc_align_float(npixels);
-  if(bufs == NULL) return 0;
+  // the shapes of the group, in the order they have to be combined
+  const int nb_forms = g_list_length(form->points);
+  dt_masks_point_group_t **fpts = malloc(sizeof(dt_masks_point_group_t *) * nb_forms);
+  dt_masks_form_t **sels = malloc(sizeof(dt_masks_form_t *) * nb_forms);
+  int *oks = malloc(sizeof(int) * nb_forms);
+  if(!fpts || !sels || !oks)
+  {
+    free(fpts);
+    free(sels);
+    free(oks);
+    return 0;
+  }
+  int k = 0;
+  for(GList *l = form->points; l; l = g_list_next(l), k++)
+  {
+    fpts[k] = (dt_masks_point_group_t *)l->data;
+    sels[k] = dt_masks_get_from_id(module->dev, fpts[k]->formid);
+  }
 
-  // and we get all masks
-  for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts))
+  // the shapes are independent, so their rasters are computed
+  // concurrently in batches of as many shapes as we have threads and
+  // memory for. they are then combined one after the other in the group
+  // order, as the combinations don't commute.
+  const size_t bufsize = sizeof(float) * npixels;
+  size_t nb_bufs = MIN((size_t)dt_get_num_threads(), (size_t)nb_forms);
+  nb_bufs = MAX(1, MIN(nb_bufs, dt_get_available_mem() / 8 / MAX(bufsize, 1)));
+
+  // we need to allocate temporary buffers for intermediate creation
+  // of individual shapes
+  float *bufs = dt_alloc_align_float(nb_bufs * npixels);
+  if(bufs == NULL && nb_bufs > 1)
   {
-    dt_masks_point_group_t *fpt = (dt_masks_point_group_t *)fpts->data;
-    dt_masks_form_t *sel = dt_masks_get_from_id(module->dev, fpt->formid);
+    nb_bufs = 1;
+    bufs = dt_alloc_align_float(npixels);
+  }
+  if(bufs == NULL)
+  {
+    free(fpts);
+    free(sels);
+    free(oks);
+    return 0;
+  }
 
-    if(sel)
+  // an export renders each mask once, no need to keep them around
+  dt_masks_raster_cache_t *cache =
+    (piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT) ? NULL : module->dev->mask_raster_cache;
+  const dt_hash_t distort_hash =
+    cache ? dt_dev_hash_distort_plus(module->dev, piece->pipe, module->iop_order,
+                                     DT_DEV_TRANSFORM_DIR_BACK_INCL)
+          : 0;
+
+  for(int first = 0; first < nb_forms; first += nb_bufs)
+  {
+    const int last = MIN(first + (int)nb_bufs, nb_forms);
+
+    // a single shape keeps the parallelism of its own rasterization
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(last - first > 1)
+#endif
+    for(int n = first; n < last; n++)
     {
-      // ensure that we start with a zeroed buffer regardless of what
-      // was previously written into 'bufs'
-      memset(bufs, 0, npixels*sizeof(float));
-      const int ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
-      const float op = fpt->opacity;
-      const int state = fpt->state;
+      float *const b = bufs + (size_t)(n - first) * npixels;
+      dt_masks_form_t *sel = sels[n];
+      oks[n] = 0;
+      if(!sel) continue;
 
-      if(darktable.dump_pfm_module)
+      const dt_hash_t hash = cache ? _raster_hash(sel, roi, piece, distort_hash) : 0;
+      if(hash && _raster_cache_get(cache, hash, b, npixels))
       {
-        char *filename = g_strdup_printf("mask-%d", fpt->formid);
+        dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+                 "[masks %d] shape %d taken from cache\n", n, sel->formid);
+        oks[n] = 1;
+      }
+      else
+      {
+        // ensure that we start with a zeroed buffer regardless of what
+        // was previously written into it
+        memset(b, 0, npixels * sizeof(float));
+        oks[n] = dt_masks_get_mask_roi(module, piece, sel, roi, b);
+        if(oks[n] && hash) _raster_cache_put(cache, hash, b, npixels);
+      }
+    }
+
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+             "[masks] shapes %d to %d of %d took %0.04f sec\n",
+             first, last - 1, nb_forms, dt_get_lap_time(&start));
+
+    for(int n = first; n < last; n++)
+    {
+      const float *const b = bufs + (size_t)(n - first) * npixels;
+
+      if(sels[n] && darktable.dump_pfm_module)
+      {
+        char *filename = g_strdup_printf("mask-%d", fpts[n]->formid);
         dt_dump_pfm(filename,
-                    bufs,
+                    b,
                     width,
                     height,
                     sizeof(float),
@@ -754,48 +1005,9 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
         g_free(filename);
       }
 
-      if(ok)
+      if(sels[n] && oks[n])
       {
-        // first see if we need to invert this shape
-        const int inverted = (state & DT_MASKS_STATE_INVERSE);
-
-        if(state & DT_MASKS_STATE_UNION)
-        {
-          _combine_masks_union(buffer, bufs, npixels, op, inverted);
-        }
-        else if(state & DT_MASKS_STATE_INTERSECTION)
-        {
-          _combine_masks_intersect(buffer, bufs, npixels, op, inverted);
-        }
-        else if(state & DT_MASKS_STATE_DIFFERENCE)
-        {
-          _combine_masks_difference(buffer, bufs, npixels, op, inverted);
-        }
-        else if(state & DT_MASKS_STATE_SUM)
-        {
-          _combine_masks_sum(buffer, bufs, npixels, op, inverted);
-        }
-        else if(state & DT_MASKS_STATE_EXCLUSION)
-        {
-          _combine_masks_exclusion(buffer, bufs, npixels, op, inverted);
-        }
-        else // if we are here, this mean that we just have to copy
-             // the shape and null other parts
-        {
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for simd default(none) \
-          dt_omp_firstprivate(npixels, op, inverted) \
-          dt_omp_sharedconst(buffer, bufs) schedule(simd:static) aligned(buffer, bufs : 64)
-#else
-#pragma omp parallel for shared(bufs, buffer)
-#endif
-#endif
-          for(int index = 0; index < npixels; index++)
-          {
-            buffer[index] = op * (inverted ? (1.0f - bufs[index]) : bufs[index]);
-          }
-        }
+        _combine_mask(buffer, b, npixels, fpts[n]->state, fpts[n]->opacity);
 
         dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
                  "[masks %d] combine took %0.04f sec\n",
@@ -803,22 +1015,30 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
 
         nb_ok++;
       }
-    }
 
-    if(darktable.dump_pfm_module)
-    {
-      char *filename = g_strdup_printf("mask-combined-%d", fpt->formid);
-      dt_dump_pfm(filename,
-                  buffer,
-                  width,
-                  height,
-                  sizeof(float),
-                  module->op);
-      g_free(filename);
+      if(darktable.dump_pfm_module)
+      {
+        char *filename = g_strdup_printf("mask-combined-%d", fpts[n]->formid);
+        dt_dump_pfm(filename,
+                    buffer,
+                    width,
+                    height,
+                    sizeof(float),
+                    module->op);
+        g_free(filename);
+      }
     }
   }
-  // and we free the intermediate buffer
+
+  dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+           "[masks] group of %d shapes, %d at a time, took %0.04f sec\n",
+           nb_forms, (int)nb_bufs, dt_get_debug_wtime() - start_group);
+
+  // and we free the intermediate buffers
   dt_free_align(bufs);
+  free(fpts);
+  free(sels);
+  free(oks);
 
   return nb_ok != 0;
 }
@@ -2922,12 +2922,14 @@ static int _path_crop_to_roi(float *path,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
+/** we write a falloff segment respecting limits of buffer, only the
+ * rows [y0, y1[ are touched */
 static void _path_falloff_roi(float *buffer,
-                              int *p0,
-                              int *p1,
+                              const int *p0,
+                              const int *p1,
                               const int bw,
-                              const int bh)
+                              const int y0,
+                              const int y1)
 {
   // segment length
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0])
@@ -2940,7 +2942,12 @@ static void _path_falloff_roi(float *buffer,
   const int dy = ly < 0 ? -1 : 1;
   const int dpy = dy * bw;
 
-  for(int i = 0; i < l; i++)
+  // skip the parts of the segment which can't reach the rows we own
+  int first = 0, last = l;
+  dt_masks_clip_segment_steps(p0[0], p0[1], lx / (float)l, ly / (float)l,
+                              0, bw, y0, y1, &first, &last);
+
+  for(int i = first; i < last; i++)
   {
     // position
     const int x = (int)((float)i * lx / (float)l) + p0[0];
@@ -2948,11 +2955,11 @@ static void _path_falloff_roi(float *buffer,
     const float op = 1.0f - (float)i / (float)l;
     float *buf = buffer + (size_t)y * bw + x;
 
-    if(x >= 0 && x < bw && y >= 0 && y < bh)
+    if(x >= 0 && x < bw && y >= y0 && y < y1)
       buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+    if(x + dx >= 0 && x + dx < bw && y >= y0 && y < y1)
       buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+    if(x >= 0 && x < bw && y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
   }
 }
@@ -3291,17 +3298,32 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
       }
     }
 
+    // the segments overlap, so rather than walking them in parallel and
+    // racing on the buffer, the roi is split in bands of rows and each
+    // band walks only the part of the segments which crosses it.
+    const int nb_bands = MAX(1, MIN(height, 4 * dt_get_num_threads()));
 #ifdef _OPENMP
 #if !defined(__SUNOS__) && !defined(__NetBSD__)
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(width, height, dindex) \
-  shared(buffer, dpoints)
+  dt_omp_firstprivate(width, height, dindex, nb_bands) \
+  shared(buffer, dpoints) schedule(dynamic)
 #else
 #pragma omp parallel for shared(buffer)
 #endif
 #endif
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
+    for(int band = 0; band < nb_bands; band++)
+    {
+      const int y0 = (int)((size_t)height * band / nb_bands);
+      const int y1 = (int)((size_t)height * (band + 1) / nb_bands);
+
+      for(int n = 0; n < dindex; n += 4)
+      {
+        const int *p0 = dpoints + n;
+        const int *p1 = dpoints + n + 2;
+        if(MAX(p0[1], p1[1]) < y0 - 1 || MIN(p0[1], p1[1]) > y1) continue;
+        _path_falloff_roi(buffer, p0, p1, width, y0, y1);
+      }
+    }
 
     dt_free_align(dpoints);
 
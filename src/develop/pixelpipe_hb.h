@@ -193,6 +193,8 @@ typedef struct dt_dev_pixelpipe_t
   GList *forms;
   // the masks generated in the pipe for later reusal are inside dt_dev_pixelpipe_iop_t
   gboolean store_all_raster_masks;
+  // forward distortions sampled on a grid, see dt_dev_distort_transform_plus()
+  GList *distort_grids;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
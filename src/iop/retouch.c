@@ -3704,6 +3704,170 @@ cleanup:
   if(img_dest) dt_free_align(img_dest);
 }
 
+// a shape to be applied on a layer, with its mask already scaled to the
+// layer. the shape writes within roi_mask_scaled and reads there and at
+// the same place shifted by the delta to its source.
+typedef struct rt_form_job_t
+{
+  dt_masks_form_t *form;
+  int index;
+  float opacity;
+  dt_iop_retouch_algo_type_t algo;
+  float dx, dy;
+  float *mask_scaled;
+  dt_iop_roi_t roi_mask_scaled;
+} rt_form_job_t;
+
+static void rt_prepare_form_job(dt_iop_module_t *self,
+                                dt_dev_pixelpipe_iop_t *piece,
+                                dt_iop_retouch_params_t *p,
+                                dt_iop_roi_t *roi_layer,
+                                rt_form_job_t *job)
+{
+  job->mask_scaled = NULL;
+
+  // get the mask
+  float *mask = NULL;
+  dt_iop_roi_t roi_mask = { 0 };
+
+  dt_masks_get_mask(self, piece, job->form, &mask,
+                    &roi_mask.width, &roi_mask.height, &roi_mask.x, &roi_mask.y);
+  if(mask == NULL)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "rt_process_forms: error retrieving mask\n");
+    return;
+  }
+
+  // search the delta with the source
+  job->algo = p->rt_forms[job->index].algorithm;
+  job->dx = job->dy = 0.f;
+
+  if(job->algo != DT_IOP_RETOUCH_BLUR && job->algo != DT_IOP_RETOUCH_FILL)
+  {
+    if(!rt_masks_get_delta_to_destination(self, piece, roi_layer, job->form,
+                                          &job->dx, &job->dy,
+                                          p->rt_forms[job->index].distort_mode))
+    {
+      dt_free_align(mask);
+      return;
+    }
+  }
+
+  // scale the mask
+  rt_build_scaled_mask(mask, &roi_mask, &job->mask_scaled, &job->roi_mask_scaled,
+                       roi_layer, job->dx, job->dy, job->algo);
+
+  // we don't need the original mask anymore
+  dt_free_align(mask);
+
+  // nothing to do for this shape
+  if(job->mask_scaled
+     && !((job->dx != 0
+           || job->dy != 0
+           || job->algo == DT_IOP_RETOUCH_BLUR
+           || job->algo == DT_IOP_RETOUCH_FILL)
+          && ((job->roi_mask_scaled.width > 2)
+              && (job->roi_mask_scaled.height > 2))))
+  {
+    dt_free_align(job->mask_scaled);
+    job->mask_scaled = NULL;
+  }
+}
+
+static void rt_apply_form_job(dt_iop_module_t *self,
+                              dt_dev_pixelpipe_iop_t *piece,
+                              dt_iop_retouch_params_t *p,
+                              float *layer,
+                              dt_iop_roi_t *roi_layer,
+                              const int ch,
+                              const gboolean mask_display,
+                              rt_form_job_t *job)
+{
+  if(job->mask_scaled == NULL) return;
+
+  const int index = job->index;
+  const float form_opacity = job->opacity;
+
+  if(job->algo == DT_IOP_RETOUCH_CLONE)
+  {
+    _retouch_clone(layer, roi_layer, job->mask_scaled,
+                   &job->roi_mask_scaled, job->dx, job->dy, form_opacity);
+  }
+  else if(job->algo == DT_IOP_RETOUCH_HEAL)
+  {
+    _retouch_heal(layer, roi_layer, job->mask_scaled,
+                  &job->roi_mask_scaled, job->dx, job->dy, form_opacity, p->max_heal_iter);
+  }
+  else if(job->algo == DT_IOP_RETOUCH_BLUR)
+  {
+    _retouch_blur(self, layer, roi_layer, job->mask_scaled,
+                  &job->roi_mask_scaled, form_opacity,
+                  p->rt_forms[index].blur_type,
+                  p->rt_forms[index].blur_radius, piece);
+  }
+  else if(job->algo == DT_IOP_RETOUCH_FILL)
+  {
+    // add a brightness to the color so it can be fine-adjusted by the user
+    dt_aligned_pixel_t fill_color;
+
+    if(p->rt_forms[index].fill_mode == DT_IOP_RETOUCH_FILL_ERASE)
+    {
+      fill_color[0] = fill_color[1] = fill_color[2] =
+        p->rt_forms[index].fill_brightness;
+    }
+    else
+    {
+      fill_color[0] =
+        p->rt_forms[index].fill_color[0] + p->rt_forms[index].fill_brightness;
+      fill_color[1] =
+        p->rt_forms[index].fill_color[1] + p->rt_forms[index].fill_brightness;
+      fill_color[2] =
+        p->rt_forms[index].fill_color[2] + p->rt_forms[index].fill_brightness;
+    }
+    fill_color[3] = 0.0f;
+
+    _retouch_fill(layer, roi_layer, job->mask_scaled,
+                  &job->roi_mask_scaled, form_opacity, fill_color);
+  }
+  else
+    dt_print(DT_DEBUG_ALWAYS,
+             "rt_process_forms: unknown algorithm %i\n", job->algo);
+
+  if(mask_display)
+    rt_copy_mask_to_alpha(layer, roi_layer, ch,
+                          job->mask_scaled, &job->roi_mask_scaled, form_opacity);
+}
+
+static gboolean rt_rects_overlap(const dt_iop_roi_t *const r1,
+                                 const int dx1,
+                                 const int dy1,
+                                 const dt_iop_roi_t *const r2,
+                                 const int dx2,
+                                 const int dy2)
+{
+  return r1->x + dx1 < r2->x + dx2 + r2->width
+    && r2->x + dx2 < r1->x + dx1 + r1->width
+    && r1->y + dy1 < r2->y + dy2 + r2->height
+    && r2->y + dy2 < r1->y + dy1 + r1->height;
+}
+
+// whether applying the two shapes in any order could give different results
+static gboolean rt_form_jobs_interfere(const rt_form_job_t *const j1,
+                                       const rt_form_job_t *const j2)
+{
+  if(j1->mask_scaled == NULL || j2->mask_scaled == NULL) return FALSE;
+
+  const dt_iop_roi_t *r1 = &j1->roi_mask_scaled;
+  const dt_iop_roi_t *r2 = &j2->roi_mask_scaled;
+  // sources are read at the destination shifted back by the delta
+  const int dx1 = -(int)j1->dx, dy1 = -(int)j1->dy;
+  const int dx2 = -(int)j2->dx, dy2 = -(int)j2->dy;
+
+  return rt_rects_overlap(r1, 0, 0, r2, 0, 0)
+    || rt_rects_overlap(r1, dx1, dy1, r2, 0, 0)
+    || rt_rects_overlap(r1, 0, 0, r2, dx2, dy2);
+}
+
 static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int scale1)
 {
   int scale = scale1;
@@ -3741,8 +3905,16 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
   if(!usr_d->suppress_mask)
   {
     const dt_masks_form_t *grp = dt_masks_get_from_id_ext(piece->pipe->forms, bp->mask_id);
-    if(grp && (grp->type & DT_MASKS_GROUP))
+    if(grp && (grp->type & DT_MASKS_GROUP) && grp->points)
     {
+      rt_form_job_t *jobs = calloc(g_list_length(grp->points), sizeof(rt_form_job_t));
+      if(jobs == NULL)
+      {
+        dt_print(DT_DEBUG_ALWAYS, "rt_process_forms: error allocating memory\n");
+        return;
+      }
+      int nb_jobs = 0;
+
       for(const GList *forms = grp->points; forms; forms = g_list_next(forms))
       {
         const dt_masks_point_group_t *grpt = (dt_masks_point_group_t *)forms->data;
@@ -3789,111 +3961,53 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
           continue;
         }
 
-        // get the mask
-        float *mask = NULL;
-        dt_iop_roi_t roi_mask = { 0 };
-
-        dt_masks_get_mask(self, piece, form, &mask,
-                          &roi_mask.width, &roi_mask.height, &roi_mask.x, &roi_mask.y);
-        if(mask == NULL)
-        {
-          dt_print(DT_DEBUG_ALWAYS, "rt_process_forms: error retrieving mask\n");
-          continue;
-        }
-
-        // search the delta with the source
-        const dt_iop_retouch_algo_type_t algo = p->rt_forms[index].algorithm;
-        float dx = 0.f, dy = 0.f;
-
-        if(algo != DT_IOP_RETOUCH_BLUR && algo != DT_IOP_RETOUCH_FILL)
-        {
-          if(!rt_masks_get_delta_to_destination(self, piece, roi_layer, form, &dx, &dy,
-                                                p->rt_forms[index].distort_mode))
-          {
-            if(mask) dt_free_align(mask);
-            continue;
-          }
-        }
-
-        // scale the mask
-        float *mask_scaled = NULL;
-        dt_iop_roi_t roi_mask_scaled = { 0 };
-
-        rt_build_scaled_mask(mask, &roi_mask,
-                             &mask_scaled, &roi_mask_scaled, roi_layer, dx, dy, algo);
+        jobs[nb_jobs].form = form;
+        jobs[nb_jobs].index = index;
+        jobs[nb_jobs].opacity = form_opacity;
+        nb_jobs++;
+      }
 
-        // we don't need the original mask anymore
-        if(mask)
-        {
-          dt_free_align(mask);
-          mask = NULL;
-        }
+      // the shapes work on their own bounding regions. their masks are
+      // built concurrently, a window of shapes at a time to bound the
+      // memory. they are then applied in order, running together the
+      // consecutive shapes whose regions don't interfere with each other.
+      const int window = MAX(1, 4 * dt_get_num_threads());
+      for(int first = 0; first < nb_jobs; first += window)
+      {
+        const int last = MIN(first + window, nb_jobs);
 
-        if(mask_scaled == NULL)
-        {
-          continue;
-        }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(last - first > 1)
+#endif
+        for(int j = first; j < last; j++)
+          rt_prepare_form_job(self, piece, p, roi_layer, &jobs[j]);
 
-        if((dx != 0
-            || dy != 0
-            || algo == DT_IOP_RETOUCH_BLUR
-            || algo == DT_IOP_RETOUCH_FILL)
-           && ((roi_mask_scaled.width > 2)
-               && (roi_mask_scaled.height > 2)))
+        int batch_start = first;
+        while(batch_start < last)
         {
-          if(algo == DT_IOP_RETOUCH_CLONE)
+          int batch_end = batch_start + 1;
+          for(gboolean free_of_conflict = TRUE; free_of_conflict && batch_end < last;)
           {
-            _retouch_clone(layer, roi_layer, mask_scaled,
-                           &roi_mask_scaled, dx, dy, form_opacity);
+            for(int j = batch_start; j < batch_end && free_of_conflict; j++)
+              free_of_conflict = !rt_form_jobs_interfere(&jobs[j], &jobs[batch_end]);
+            if(free_of_conflict) batch_end++;
           }
-          else if(algo == DT_IOP_RETOUCH_HEAL)
-          {
-            _retouch_heal(layer, roi_layer, mask_scaled,
-                          &roi_mask_scaled, dx, dy, form_opacity, p->max_heal_iter);
-          }
-          else if(algo == DT_IOP_RETOUCH_BLUR)
-          {
-            _retouch_blur(self, layer, roi_layer, mask_scaled,
-                          &roi_mask_scaled, form_opacity,
-                          p->rt_forms[index].blur_type,
-                          p->rt_forms[index].blur_radius, piece);
-          }
-          else if(algo == DT_IOP_RETOUCH_FILL)
-          {
-            // add a brightness to the color so it can be fine-adjusted by the user
-            dt_aligned_pixel_t fill_color;
 
-            if(p->rt_forms[index].fill_mode == DT_IOP_RETOUCH_FILL_ERASE)
-            {
-              fill_color[0] = fill_color[1] = fill_color[2] =
-                p->rt_forms[index].fill_brightness;
-            }
-            else
-            {
-              fill_color[0] =
-                p->rt_forms[index].fill_color[0] + p->rt_forms[index].fill_brightness;
-              fill_color[1] =
-                p->rt_forms[index].fill_color[1] + p->rt_forms[index].fill_brightness;
-              fill_color[2] =
-                p->rt_forms[index].fill_color[2] + p->rt_forms[index].fill_brightness;
-            }
-            fill_color[3] = 0.0f;
-
-            _retouch_fill(layer, roi_layer, mask_scaled,
-                          &roi_mask_scaled, form_opacity, fill_color);
-          }
-          else
-            dt_print(DT_DEBUG_ALWAYS,
-                     "rt_process_forms: unknown algorithm %i\n", algo);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(batch_end - batch_start > 1)
+#endif
+          for(int j = batch_start; j < batch_end; j++)
+            rt_apply_form_job(self, piece, p, layer, roi_layer, wt_p->ch,
+                              mask_display, &jobs[j]);
 
-          if(mask_display)
-            rt_copy_mask_to_alpha(layer, roi_layer, wt_p->ch,
-                                  mask_scaled, &roi_mask_scaled, form_opacity);
+          batch_start = batch_end;
         }
 
-        if(mask) dt_free_align(mask);
-        if(mask_scaled) dt_free_align(mask_scaled);
+        for(int j = first; j < last; j++)
+          if(jobs[j].mask_scaled) dt_free_align(jobs[j].mask_scaled);
       }
+
+      free(jobs);
     }
   }
 }
@@ -146,6 +146,7 @@ typedef struct dt_lib_filtering_t
   struct dt_lib_filtering_params_t *params;
 
   gchar *last_where_ext;
+  GHashTable *facets; // prop -> GArray of _facet_count_t, for last_where_ext
 } dt_lib_filtering_t;
 
 typedef struct dt_lib_filtering_params_rule_t
@@ -212,6 +213,189 @@ typedef struct _filter_t
 } _filter_t;
 
 
+// the range filters show the number of images per value of their property.
+// instead of letting each of them run its own GROUP BY, the counts of all
+// the shown properties are gathered in one scan over the base collection
+// and kept until the collection or the images info change.
+typedef struct _facet_count_t
+{
+  double value;
+  int count;
+} _facet_count_t;
+
+typedef struct _facet_def_t
+{
+  dt_collection_properties_t prop;
+  const char *expr;
+  gboolean is_date; // 64 bits values, NULL ones are ignored
+} _facet_def_t;
+
+// clang-format off
+static const _facet_def_t _facets_def[]
+    = { { DT_COLLECTION_PROP_APERTURE, "ROUND(aperture,1)", FALSE },
+        { DT_COLLECTION_PROP_EXPOSURE, "exposure", FALSE },
+        { DT_COLLECTION_PROP_FOCAL_LENGTH, "ROUND(focal_length,0)", FALSE },
+        { DT_COLLECTION_PROP_ISO, "ROUND(iso,0)", FALSE },
+        { DT_COLLECTION_PROP_ASPECT_RATIO, "ROUND(aspect_ratio,3)", FALSE },
+        { DT_COLLECTION_PROP_RATING_RANGE, "CASE WHEN (flags & 8) == 8 THEN -1 ELSE (flags & 7) END", FALSE },
+        { DT_COLLECTION_PROP_DAY, "datetime_taken", TRUE },
+        { DT_COLLECTION_PROP_IMPORT_TIMESTAMP, "import_timestamp", TRUE },
+        { DT_COLLECTION_PROP_CHANGE_TIMESTAMP, "change_timestamp", TRUE },
+        { DT_COLLECTION_PROP_EXPORT_TIMESTAMP, "export_timestamp", TRUE },
+        { DT_COLLECTION_PROP_PRINT_TIMESTAMP, "print_timestamp", TRUE } };
+// clang-format on
+
+#define FACETS_NB (sizeof(_facets_def) / sizeof(_facet_def_t))
+
+static const _facet_def_t *_facet_def_get(const dt_collection_properties_t prop)
+{
+  for(int i = 0; i < FACETS_NB; i++)
+    if(_facets_def[i].prop == prop) return &_facets_def[i];
+  return NULL;
+}
+
+static int _facet_sort_double(gconstpointer a, gconstpointer b)
+{
+  const double da = *(const double *)a;
+  const double db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+static int _facet_sort_int64(gconstpointer a, gconstpointer b)
+{
+  const gint64 ia = *(const gint64 *)a;
+  const gint64 ib = *(const gint64 *)b;
+  return (ia > ib) - (ia < ib);
+}
+
+// sort the raw values and count the occurrences of each of them, the
+// result is ordered the same way as the GROUP BY queries it replaces
+static GArray *_facet_counts_from_values(GArray *values, const gboolean is_date)
+{
+  GArray *counts = g_array_new(FALSE, FALSE, sizeof(_facet_count_t));
+  g_array_sort(values, is_date ? _facet_sort_int64 : _facet_sort_double);
+
+  for(int i = 0; i < values->len;)
+  {
+    int j = i + 1;
+    if(is_date)
+    {
+      const gint64 v = g_array_index(values, gint64, i);
+      while(j < values->len && g_array_index(values, gint64, j) == v) j++;
+      const _facet_count_t c = { (double)v, j - i };
+      g_array_append_val(counts, c);
+    }
+    else
+    {
+      const double v = g_array_index(values, double, i);
+      while(j < values->len && g_array_index(values, double, j) == v) j++;
+      const _facet_count_t c = { v, j - i };
+      g_array_append_val(counts, c);
+    }
+    i = j;
+  }
+  return counts;
+}
+
+static void _facets_invalidate(dt_lib_filtering_t *d)
+{
+  if(d->facets) g_hash_table_remove_all(d->facets);
+}
+
+// compute in one scan the counts of the given property and of all the other
+// shown range filters which are not already known
+static void _facets_compute(dt_lib_filtering_t *d, const dt_collection_properties_t prop)
+{
+  const _facet_def_t *defs[FACETS_NB];
+  int nb = 0;
+
+  for(int i = -1; i < d->nb_rules; i++)
+  {
+    dt_collection_properties_t p = prop;
+    if(i >= 0)
+    {
+      // only the rules which have widgets need their counts
+      if(!d->rule[i].w_specific && !d->rule[i].w_specific_top) continue;
+      p = d->rule[i].prop;
+    }
+    const _facet_def_t *def = _facet_def_get(p);
+    if(!def || g_hash_table_contains(d->facets, GINT_TO_POINTER(p))) continue;
+    gboolean found = FALSE;
+    for(int k = 0; k < nb && !found; k++) found = (defs[k] == def);
+    if(!found) defs[nb++] = def;
+  }
+  if(nb == 0) return;
+
+  const double start = dt_get_debug_wtime();
+
+  gchar *cols = NULL;
+  for(int k = 0; k < nb; k++)
+    cols = dt_util_dstrcat(cols, "%s%s", k ? ", " : "", defs[k]->expr);
+
+  // clang-format off
+  gchar *query = g_strdup_printf("SELECT %s"
+                                 " FROM main.images AS mi"
+                                 " WHERE %s",
+                                 cols, d->last_where_ext);
+  // clang-format on
+  g_free(cols);
+
+  GArray *values[FACETS_NB];
+  for(int k = 0; k < nb; k++)
+    values[k] = g_array_new(FALSE, FALSE, defs[k]->is_date ? sizeof(gint64) : sizeof(double));
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  int nb_images = 0;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    for(int k = 0; k < nb; k++)
+    {
+      if(defs[k]->is_date)
+      {
+        if(sqlite3_column_type(stmt, k) == SQLITE_NULL) continue;
+        const gint64 v = sqlite3_column_int64(stmt, k);
+        g_array_append_val(values[k], v);
+      }
+      else
+      {
+        const double v = sqlite3_column_double(stmt, k);
+        g_array_append_val(values[k], v);
+      }
+    }
+    nb_images++;
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  for(int k = 0; k < nb; k++)
+  {
+    g_hash_table_insert(d->facets, GINT_TO_POINTER(defs[k]->prop),
+                        _facet_counts_from_values(values[k], defs[k]->is_date));
+    g_array_free(values[k], TRUE);
+  }
+
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF,
+           "[filtering] counts of %d properties over %d images took %.3f secs\n",
+           nb, nb_images, dt_get_debug_wtime() - start);
+}
+
+// return the counts per value of the property for the current collection
+static const GArray *_facets_get(dt_lib_filtering_t *d, const dt_collection_properties_t prop)
+{
+  if(!d->facets)
+    d->facets = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)g_array_unref);
+
+  GArray *counts = g_hash_table_lookup(d->facets, GINT_TO_POINTER(prop));
+  if(!counts)
+  {
+    _facets_compute(d, prop);
+    counts = g_hash_table_lookup(d->facets, GINT_TO_POINTER(prop));
+  }
+  return counts;
+}
+
+
 // filters definitions
 #include "libs/filters/aperture.c"
 #include "libs/filters/camera.c"
@@ -1451,6 +1635,9 @@ static void _dt_collection_updated(gpointer instance, dt_collection_change_t que
   dt_lib_module_t *dm = (dt_lib_module_t *)self;
   dt_lib_filtering_t *d = (dt_lib_filtering_t *)dm->data;
 
+  // the images may have changed even if the query is the same
+  _facets_invalidate(d);
+
   gchar *where_ext = dt_collection_get_extended_where(darktable.collection, 99999);
   if(g_strcmp0(where_ext, d->last_where_ext))
   {
@@ -1463,6 +1650,12 @@ static void _dt_collection_updated(gpointer instance, dt_collection_change_t que
   }
 }
 
+static void _image_info_changed(gpointer instance, gpointer imgs, gpointer self)
+{
+  dt_lib_module_t *dm = (dt_lib_module_t *)self;
+  _facets_invalidate((dt_lib_filtering_t *)dm->data);
+}
+
 static void _history_pretty_print(const char *buf, char *out, size_t outsize)
 {
   memset(out, 0, outsize);
@@ -2275,6 +2468,8 @@ void gui_init(dt_lib_module_t *self)
                                   G_CALLBACK(_dt_collection_updated), self);
   DT_DEBUG_CONTROL_SIGNAL_CONNECT(darktable.signals, DT_SIGNAL_IMAGES_ORDER_CHANGE,
                                   G_CALLBACK(_dt_images_order_change), self);
+  DT_DEBUG_CONTROL_SIGNAL_CONNECT(darktable.signals, DT_SIGNAL_IMAGE_INFO_CHANGED,
+                                  G_CALLBACK(_image_info_changed), self);
 }
 
 void gui_cleanup(dt_lib_module_t *self)
@@ -2287,8 +2482,10 @@ void gui_cleanup(dt_lib_module_t *self)
   }
 
   DT_DEBUG_CONTROL_SIGNAL_DISCONNECT(darktable.signals, G_CALLBACK(_dt_collection_updated), self);
+  DT_DEBUG_CONTROL_SIGNAL_DISCONNECT(darktable.signals, G_CALLBACK(_image_info_changed), self);
   darktable.view_manager->proxy.module_filtering.module = NULL;
   free(d->params);
+  if(d->facets) g_hash_table_destroy(d->facets);
 
   /* TODO: Make sure we are cleaning up all allocations */
 
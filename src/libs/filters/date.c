@@ -49,29 +49,15 @@ static gboolean _date_update(dt_lib_filtering_rule_t *rule)
 
   rule->manual_widget_set++;
   // first, we update the graph
-  gchar *colname = _date_get_db_colname(rule);
-  char query[1024] = { 0 };
-  // clang-format off
-  g_snprintf(query, sizeof(query),
-             "SELECT %s AS date, COUNT(*) AS count"
-             " FROM main.images AS mi"
-             " WHERE %s IS NOT NULL AND %s"
-             " GROUP BY date",
-             colname, colname, d->last_where_ext);
-  // clang-format on
-  g_free(colname);
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  const GArray *counts = _facets_get(d, rule->prop);
   dtgtk_range_select_reset_blocks(range);
   if(rangetop) dtgtk_range_select_reset_blocks(rangetop);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(int i = 0; counts && i < counts->len; i++)
   {
-    const int count = sqlite3_column_int(stmt, 1);
-    const int64_t dt = sqlite3_column_int64(stmt, 0);
-    dtgtk_range_select_add_block(range, dt, count);
-    if(rangetop) dtgtk_range_select_add_block(rangetop, dt, count);
+    const _facet_count_t *c = &g_array_index(counts, _facet_count_t, i);
+    dtgtk_range_select_add_block(range, c->value, c->count);
+    if(rangetop) dtgtk_range_select_add_block(rangetop, c->value, c->count);
   }
-  sqlite3_finalize(stmt);
 
   // and setup the selection
   dtgtk_range_select_set_selection_from_raw_text(range, rule->raw_text, FALSE);
@@ -0,0 +1,153 @@
+#!/bin/bash
+
+#
+# Usage: generate_benchmark_library -l <library.db> -d <data.db> [-n <images>]
+#
+# Fill a darktable library with synthetic images, tags, color labels and
+# metadata to benchmark collection queries on large libraries, e.g. with
+#
+#   darktable --library <library.db> --configdir <dir> -d sql -d perf
+#
+# The databases must have been created by darktable beforehand (start it
+# once with --library and --configdir pointing to a scratch directory) so
+# that the schema is the current one. Never run this on your real library.
+#
+
+if ! which sqlite3 > /dev/null; then
+    echo "error: please install sqlite3 binary".
+    exit 1
+fi
+
+LIBDB=""
+DATADB=""
+images=300000
+
+# handle command line arguments
+while [ "$#" -ge 1 ] ; do
+  option="$1"
+  case ${option} in
+  -h|--help)
+    echo "Fill a scratch darktable library with synthetic images for benchmarking"
+    echo "Usage:   $0 [options]"
+    echo ""
+    echo "Options:"
+    echo "  -l|--library <path>      path to the library.db to fill"
+    echo "  -d|--data <path>         path to the matching data.db (for tags)"
+    echo "  -n|--images <number>     number of images to create"
+    echo "                           (default: '${images}')"
+    exit 0
+    ;;
+  -l|--library)
+    LIBDB="$2"
+    shift
+    ;;
+  -d|--data)
+    DATADB="$2"
+    shift
+    ;;
+  -n|--images)
+    images="$2"
+    shift
+    ;;
+  *)
+    echo "warning: ignoring unknown option $option"
+    ;;
+  esac
+    shift
+done
+
+if [ ! -f "$LIBDB" ]; then
+    echo "error: library db '${LIBDB}' doesn't exist"
+    exit 1
+fi
+
+if [ ! -f "$DATADB" ]; then
+    echo "error: data db '${DATADB}' doesn't exist"
+    exit 1
+fi
+
+if ! [[ "$images" =~ ^[0-9]+$ ]] || [ "$images" -lt 1 ]; then
+    echo "error: invalid number of images '${images}'"
+    exit 1
+fi
+
+echo "Creating ${images} synthetic images in ${LIBDB}..."
+
+# 300 images per film roll, 40 camera bodies, 60 lenses, 2000 tags in a
+# three level hierarchy, up to 5 tags, a color label for every 4th and a
+# title for every 3rd image. dates spread over 15 years.
+Q="
+ATTACH DATABASE \"$LIBDB\" AS lib;
+ATTACH DATABASE \"$DATADB\" AS data;
+BEGIN;
+
+CREATE TEMP TABLE seq (n INTEGER PRIMARY KEY);
+WITH RECURSIVE c(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM c WHERE n < $images)
+  INSERT INTO seq SELECT n FROM c;
+
+INSERT OR IGNORE INTO lib.makers (name)
+  SELECT 'bench maker ' || (n % 4) FROM seq WHERE n <= 4;
+INSERT OR IGNORE INTO lib.models (name)
+  SELECT 'bench model ' || n FROM seq WHERE n <= 40;
+INSERT OR IGNORE INTO lib.lens (name)
+  SELECT 'bench lens ' || n || 'mm' FROM seq WHERE n <= 60;
+INSERT OR IGNORE INTO lib.cameras (maker, model, alias)
+  SELECT 'bench maker ' || (n % 4), 'bench model ' || n, 'bench ' || n FROM seq WHERE n <= 40;
+
+INSERT INTO lib.film_rolls (access_timestamp, folder)
+  SELECT 0, '/benchmark/' || (2010 + n % 15) || '/roll ' || n
+  FROM seq WHERE n <= ($images + 299) / 300;
+
+CREATE TEMP TABLE rolls AS
+  SELECT ROW_NUMBER() OVER (ORDER BY id) - 1 AS nr, id FROM lib.film_rolls
+  WHERE folder LIKE '/benchmark/%';
+
+INSERT INTO lib.images
+  (group_id, film_id, width, height, filename, maker_id, model_id, lens_id, camera_id,
+   exposure, aperture, iso, focal_length, focus_distance, datetime_taken, flags,
+   output_width, output_height, crop, raw_parameters, raw_black, raw_maximum,
+   orientation, version, max_version, history_end, position, aspect_ratio,
+   exposure_bias, import_timestamp, change_timestamp, export_timestamp, print_timestamp)
+  SELECT
+   -1, r.id, 6000, 4000, 'IMG_' || s.n || '.CR2',
+   (SELECT id FROM lib.makers WHERE name = 'bench maker ' || (s.n % 40 % 4)),
+   (SELECT id FROM lib.models WHERE name = 'bench model ' || (s.n % 40 + 1)),
+   (SELECT id FROM lib.lens WHERE name = 'bench lens ' || (s.n % 60 + 1) || 'mm'),
+   (SELECT id FROM lib.cameras WHERE alias = 'bench ' || (s.n % 40 + 1)),
+   1.0 / (1 << (s.n % 12)), 1.4 * (1 + s.n % 8), 100 << (s.n % 7), 12 + s.n % 600,
+   0, 63397440000000000 + s.n * 1576800000, (s.n % 6) | 64,
+   0, 0, 0, 0, 0, 0,
+   -1, 0, 0, 0, s.n << 32, 1.5,
+   0, 63397440000000000 + s.n * 1576800000, -1, -1, -1
+  FROM seq s JOIN rolls r ON r.nr = (s.n - 1) / 300;
+
+UPDATE lib.images SET group_id = id WHERE group_id = -1;
+
+INSERT INTO data.tags (name, synonyms, flags)
+  SELECT 'benchmark|subject ' || (n % 20) || '|tag ' || n, '', 0 FROM seq WHERE n <= 2000;
+
+CREATE TEMP TABLE bench_tags AS
+  SELECT ROW_NUMBER() OVER (ORDER BY id) - 1 AS nr, id FROM data.tags
+  WHERE name LIKE 'benchmark|%';
+
+INSERT OR IGNORE INTO lib.tagged_images (imgid, tagid, position)
+  SELECT i.id, t.id, 0
+  FROM lib.images i, (SELECT n AS k FROM seq WHERE n <= 5) AS k
+  JOIN bench_tags t ON t.nr = (i.id * 7919 + k.k * 104729) % 2000
+  WHERE i.filename LIKE 'IMG\_%' ESCAPE '\\' AND k.k <= i.id % 6;
+
+INSERT OR IGNORE INTO lib.color_labels (imgid, color)
+  SELECT id, id % 5 FROM lib.images WHERE id % 4 = 0;
+
+INSERT OR IGNORE INTO lib.meta_data (id, key, value)
+  SELECT id, 2, 'benchmark title ' || (id % 1000) FROM lib.images WHERE id % 3 = 0;
+
+COMMIT;
+"
+
+echo "$Q" | sqlite3 || exit 1
+
+sqlite3 "$LIBDB" "ANALYZE;"
+sqlite3 "$DATADB" "ANALYZE;"
+
+echo "done."